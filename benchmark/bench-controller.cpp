@@ -0,0 +1,119 @@
+/*
+   End-to-end benchmark of RCSotController without a robot: the controller
+   is initialized against a mock RobotHW and loads the stub SoT device
+   (stub-sot-device.cpp). update() is called as fast as possible while the
+   dynamic graph is stopped (standby) and once it is started (nominal).
+
+   The configuration goes through the parameter server, and the dynamic
+   graph is started with the /start_dynamic_graph service: a roscore has
+   to be running.
+
+   Usage: roscontrol-sot-bench-controller
+            [nbJoints [nbImus [nbForceSensors [nbIterations [EFFORT|POSITION]]]]]
+*/
+#include <time.h>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+#include <ros/ros.h>
+#include <std_srvs/Empty.h>
+
+#include "roscontrol-sot-controller.hh"
+#include "mock-robot-hw.hh"
+
+using namespace sot_controller;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+/// Returns the mean time of update() in ns.
+static double benchUpdate(RCSotController &controller, MockRobotHW &robot,
+			  ros::Time &time, double dt,
+			  unsigned int nbIterations)
+{
+  ros::Duration period(dt);
+  double start = now();
+  for(unsigned int k=0;k<nbIterations;k++)
+    {
+      robot.read();
+      time += period;
+      controller.update(time,period);
+    }
+  return 1e9*(now()-start)/nbIterations;
+}
+
+int main(int argc, char *argv[])
+{
+  ros::init(argc,argv,"roscontrol_sot_bench_controller");
+  unsigned int nbJoints = 32, nbImus = 1, nbForceSensors = 4,
+    nbIterations = 100000;
+  std::string controlMode("EFFORT");
+  if (argc>1)
+    nbJoints = (unsigned int)atoi(argv[1]);
+  if (argc>2)
+    nbImus = (unsigned int)atoi(argv[2]);
+  if (argc>3)
+    nbForceSensors = (unsigned int)atoi(argv[3]);
+  if (argc>4)
+    nbIterations = (unsigned int)atoi(argv[4]);
+  if (argc>5)
+    controlMode = argv[5];
+  /// The log has room for 4 force sensors.
+  if (nbForceSensors>4)
+    nbForceSensors = 4;
+
+  if (!ros::master::check())
+    {
+      std::cerr << "This benchmark needs a roscore." << std::endl;
+      return 1;
+    }
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  const double dt = 1e-3;
+  MockRobotHW robot(nbJoints,nbImus,nbForceSensors);
+  setControllerParams(robot,controlMode,dt);
+
+  RCSotController controller;
+  ros::NodeHandle robot_nh, controller_nh("sot_controller");
+#ifdef CONTROLLER_INTERFACE_KINETIC
+  lci::ControllerBase::ClaimedResources claimed_resources;
+#else
+  ClaimedResources claimed_resources;
+#endif
+  if (!controller.initRequest(&robot,robot_nh,controller_nh,
+			      claimed_resources))
+    {
+      std::cerr << "Failed to initialize the controller." << std::endl;
+      return 1;
+    }
+
+  ros::Time time(0.0);
+  controller.starting(time);
+  double standby = benchUpdate(controller,robot,time,dt,nbIterations);
+
+  std_srvs::Empty srv;
+  if (!ros::service::call("/start_dynamic_graph",srv))
+    {
+      std::cerr << "Failed to start the dynamic graph." << std::endl;
+      return 1;
+    }
+  double nominal = benchUpdate(controller,robot,time,dt,nbIterations);
+
+  std::cout << std::fixed << std::setprecision(1)
+	    << "joints: " << nbJoints << ", imus: " << nbImus
+	    << ", force sensors: " << nbForceSensors
+	    << ", mode: " << controlMode << '\n'
+	    << "standby: " << std::setw(10) << standby << " ns/iteration\n"
+	    << "nominal: " << std::setw(10) << nominal << " ns/iteration"
+	    << std::endl;
+
+  spinner.stop();
+  return 0;
+}
@@ -0,0 +1,241 @@
+/*
+   Microbenchmarks of the per-iteration paths of the controller for 12, 32
+   and 64 joints: Log::record, Log::save, DataToLog::init, and fillJoints,
+   fillImu, fillForceSensors and readControl on the handles of a mock
+   robot (mock-robot-hw.hh).
+
+   The results are printed as JSON (default) or CSV to be compared
+   between commits. The controller paths need a roscore to read the
+   parameters; without one they are skipped.
+
+   Usage: roscontrol-sot-bench-hot-paths [json|csv [nbIterations [prefix]]]
+*/
+#include <time.h>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+
+#include "log.hh"
+#include "hot-path-controller.hh"
+
+using namespace rc_sot_system;
+using namespace sot_controller;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+/// Number of repetitions of each measure, the best one is reported too.
+static const unsigned int NB_RUNS = 5;
+
+struct BenchResult
+{
+  std::string name;
+  unsigned int dofs;
+  unsigned long iterations;
+  /// Mean and best (over the runs) time of one operation.
+  double mean_ns, best_ns;
+};
+
+/// One measured operation.
+class BenchCase
+{
+public:
+  virtual ~BenchCase() {}
+  virtual void run() = 0;
+};
+
+static BenchResult measure(const std::string &name, unsigned int dofs,
+			   BenchCase &bench, unsigned long nbIterations)
+{
+  BenchResult result;
+  result.name = name;
+  result.dofs = dofs;
+  result.iterations = nbIterations;
+  result.best_ns = 1e30;
+  double total = 0.0;
+  for(unsigned int r=0;r<NB_RUNS;r++)
+    {
+      double start = now();
+      for(unsigned long k=0;k<nbIterations;k++)
+	bench.run();
+      double elapsed = 1e9*(now()-start)/(double)nbIterations;
+      total += elapsed;
+      if (elapsed<result.best_ns)
+	result.best_ns = elapsed;
+    }
+  result.mean_ns = total/NB_RUNS;
+  return result;
+}
+
+///@{ \name Log
+class RecordCase : public BenchCase
+{
+public:
+  RecordCase(unsigned int nbDofs, unsigned int length)
+  {
+    log_.init(nbDofs,length);
+    data_.init(nbDofs,1);
+    for(unsigned int i=0;i<nbDofs;i++)
+      data_.motor_angle[i] = data_.joint_angle[i] = std::sin((double)i);
+  }
+  void run() { log_.record(data_); }
+private:
+  Log log_;
+  DataToLog data_;
+};
+
+class SaveCase : public BenchCase
+{
+public:
+  SaveCase(unsigned int nbDofs, unsigned int length,
+	   const std::string &prefix):
+    prefix_(prefix)
+  {
+    log_.init(nbDofs,length);
+    DataToLog data;
+    data.init(nbDofs,1);
+    for(unsigned int k=0;k<length;k++)
+      {
+	for(unsigned int i=0;i<nbDofs;i++)
+	  data.motor_angle[i] = data.joint_angle[i] = std::sin(1e-3*k+i);
+	log_.record(data);
+      }
+  }
+  void run() { log_.save(prefix_); }
+private:
+  Log log_;
+  std::string prefix_;
+};
+
+class InitCase : public BenchCase
+{
+public:
+  InitCase(unsigned int nbDofs): nbDofs_(nbDofs) {}
+  void run()
+  {
+    DataToLog data;
+    data.init(nbDofs_,1);
+  }
+private:
+  unsigned int nbDofs_;
+};
+///@}
+
+///@{ \name Controller
+class ControllerCase : public BenchCase
+{
+public:
+  typedef void (HotPathController::*Step)();
+  ControllerCase(HotPathController &controller, Step step):
+    controller_(controller), step_(step) {}
+  void run() { (controller_.*step_)(); }
+private:
+  HotPathController &controller_;
+  Step step_;
+};
+
+static bool benchController(unsigned int nbDofs, unsigned long nbIterations,
+			    std::vector<BenchResult> &results)
+{
+  MockRobotHW robot(nbDofs,1,4);
+  setControllerParams(robot,"POSITION",1e-3);
+  HotPathController controller;
+  if (!controller.initOnMock(robot))
+    return false;
+
+  const char * names[4] =
+    { "fillJoints", "fillImu", "fillForceSensors", "readControl" };
+  const ControllerCase::Step steps[4] =
+    { &HotPathController::benchFillJoints,
+      &HotPathController::benchFillImu,
+      &HotPathController::benchFillForceSensors,
+      &HotPathController::benchReadControl };
+  for(unsigned int i=0;i<4;i++)
+    {
+      ControllerCase bench(controller,steps[i]);
+      results.push_back(measure(names[i],nbDofs,bench,nbIterations));
+    }
+  return true;
+}
+///@}
+
+static void printJson(const std::vector<BenchResult> &results)
+{
+  std::cout << std::fixed << std::setprecision(1) << "[\n";
+  for(std::size_t i=0;i<results.size();i++)
+    std::cout << "  {\"name\": \"" << results[i].name << "\", "
+	      << "\"dofs\": " << results[i].dofs << ", "
+	      << "\"iterations\": " << results[i].iterations << ", "
+	      << "\"mean_ns\": " << results[i].mean_ns << ", "
+	      << "\"best_ns\": " << results[i].best_ns << '}'
+	      << (i+1<results.size() ? ",\n" : "\n");
+  std::cout << ']' << std::endl;
+}
+
+static void printCsv(const std::vector<BenchResult> &results)
+{
+  std::cout << std::fixed << std::setprecision(1)
+	    << "name,dofs,iterations,mean_ns,best_ns\n";
+  for(std::size_t i=0;i<results.size();i++)
+    std::cout << results[i].name << ',' << results[i].dofs << ','
+	      << results[i].iterations << ',' << results[i].mean_ns << ','
+	      << results[i].best_ns << '\n';
+  std::cout << std::flush;
+}
+
+int main(int argc, char *argv[])
+{
+  ros::init(argc,argv,"roscontrol_sot_bench_hot_paths");
+  /// Keep stdout for the results: Log::save reports each file at INFO.
+  if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME,
+				     ros::console::levels::Warn))
+    ros::console::notifyLoggerLevelsChanged();
+  std::string format("json"), prefix("/tmp/bench-hot-paths");
+  unsigned long nbIterations = 100000;
+  if (argc>1)
+    format = argv[1];
+  if (argc>2)
+    nbIterations = (unsigned long)atol(argv[2]);
+  if (argc>3)
+    prefix = argv[3];
+
+  /// The saved log covers 10s at 1kHz.
+  const unsigned int saveLength = 10000;
+  const unsigned int nbDofs[3] = { 12, 32, 64 };
+  bool withController = ros::master::check();
+  if (!withController)
+    std::cerr << "No roscore: the controller paths are skipped." << std::endl;
+
+  std::vector<BenchResult> results;
+  for(unsigned int d=0;d<3;d++)
+    {
+      RecordCase record(nbDofs[d],(unsigned int)nbIterations);
+      results.push_back(measure("Log::record",nbDofs[d],record,nbIterations));
+
+      SaveCase save(nbDofs[d],saveLength,prefix);
+      results.push_back(measure("Log::save",nbDofs[d],save,1));
+
+      InitCase init(nbDofs[d]);
+      results.push_back(measure("DataToLog::init",nbDofs[d],init,
+				nbIterations/10+1));
+
+      if (withController && !benchController(nbDofs[d],nbIterations,results))
+	std::cerr << "Failed to initialize the controller with "
+		  << nbDofs[d] << " joints." << std::endl;
+    }
+
+  if (format=="csv")
+    printCsv(results);
+  else
+    printJson(results);
+  return 0;
+}
@@ -0,0 +1,145 @@
+/*
+   Benchmark of the lossless compression of the log container:
+   a full buffer of 300s at 1kHz with 32 joints is saved raw and
+   compressed, and the compressed columns are decoded back.
+*/
+#include <time.h>
+#include <sys/stat.h>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include "log.hh"
+#include "log-format.hh"
+#include "log-codec.hh"
+
+using namespace rc_sot_system;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+static double fileSize(const std::string &fileName)
+{
+  struct stat st;
+  if (stat(fileName.c_str(),&st)!=0)
+    return 0.0;
+  return (double)st.st_size;
+}
+
+/// Quantize a value to the resolution of a sensor.
+static double quantize(double value, double resolution)
+{
+  return resolution*std::floor(value/resolution+0.5);
+}
+
+/// Fill the log with signals looking like the ones of a robot:
+/// encoder angles, velocities derived from them, quantized torques,
+/// IMU and force sensors with noise, temperatures changing rarely.
+static void fillLog(Log &log, unsigned int nbDofs, unsigned int nbSamples)
+{
+  DataToLog data;
+  data.init(nbDofs,1);
+  const double encoder = 2*M_PI/(1<<19), dt = 1e-3;
+  std::vector<double> previous(nbDofs,0.0);
+  srand(0);
+  for(unsigned int k=0;k<nbSamples;k++)
+    {
+      double t = dt*k;
+      for(unsigned int i=0;i<nbDofs;i++)
+	{
+	  double q = quantize(0.3*std::sin(0.5*t+i),encoder);
+	  data.motor_angle[i] = q;
+	  data.joint_angle[i] = quantize(q+1e-4*std::sin(3*t),encoder);
+	  data.velocities[i] = (q-previous[i])/dt;
+	  previous[i] = q;
+	  data.torques[i] = quantize(20*std::cos(0.5*t+i),1e-2);
+	  data.motor_currents[i] = quantize(data.torques[i]/10,1e-3);
+	  data.temperatures[i] = quantize(40+i+t/60,0.5);
+	}
+      for(unsigned int i=0;i<3;i++)
+	{
+	  data.accelerometer[i] = (i==2 ? 9.81 : 0.0) + 1e-3*(rand()%100);
+	  data.gyrometer[i] = 1e-4*(rand()%100);
+	}
+      for(unsigned int i=0;i<24;i++)
+	data.force_sensors[i] = quantize((i%6<3 ? 200 : 10)*std::sin(t)
+					 + 0.1*(rand()%10),1e-2);
+      log.record(data);
+    }
+}
+
+/// Decode all the columns of a compressed container.
+/// Returns the number of decoded values.
+static unsigned long decodeContainer(const std::string &fileName)
+{
+  std::ifstream in(fileName.c_str(), std::ios::binary);
+  LogHeader header;
+  if (!readLogHeader(in,header))
+    return 0;
+  std::vector<double> column(header.nbSamples+1);
+  std::vector<unsigned char> encoded;
+  unsigned long nbValues = 0;
+  for(std::size_t i=0;i<header.channels.size();i++)
+    for(std::size_t j=0;j<header.channels[i].columns.size();j++)
+      {
+	uint64_t table[2];
+	in.seekg(header.channels[i].offset + j*sizeof(table));
+	in.read((char*)table,sizeof(table));
+	encoded.resize(table[1]+1);
+	in.seekg(table[0]);
+	in.read((char*)&encoded[0],table[1]);
+	decodeLogColumn(&encoded[0],table[1],header.nbSamples,&column[0]);
+	nbValues += header.nbSamples;
+      }
+  return nbValues;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned int nbSamples = 300000, nbDofs = 32;
+  if (argc>1)
+    nbSamples = (unsigned int)atoi(argv[1]);
+  if (argc>2)
+    nbDofs = (unsigned int)atoi(argv[2]);
+
+  Log log;
+  log.init(nbDofs,nbSamples);
+  fillLog(log,nbDofs,nbSamples);
+  log.setFormat(LOG_FORMAT_CONTAINER);
+
+  std::string raw("/tmp/bench-log-codec-raw.log"),
+    compressed("/tmp/bench-log-codec-xor.log");
+
+  double start = now();
+  log.save(raw);
+  double traw = now()-start;
+
+  log.setCompression(true);
+  start = now();
+  log.save(compressed);
+  double txor = now()-start;
+
+  start = now();
+  unsigned long nbValues = decodeContainer(compressed);
+  double tdecode = now()-start;
+
+  const double mb = 1e-6*8*(double)nbValues;
+  std::cout << std::fixed << std::setprecision(2)
+	    << "samples: " << nbSamples << ", dofs: " << nbDofs << '\n'
+	    << "raw:        " << 1e-6*fileSize(raw) << " MB in "
+	    << 1e3*traw << " ms\n"
+	    << "compressed: " << 1e-6*fileSize(compressed) << " MB in "
+	    << 1e3*txor << " ms\n"
+	    << "ratio:      " << fileSize(raw)/fileSize(compressed) << '\n'
+	    << "encode:     " << mb/txor << " MB/s (including the write)\n"
+	    << "decode:     " << mb/tdecode << " MB/s (including the read)"
+	    << std::endl;
+  return 0;
+}
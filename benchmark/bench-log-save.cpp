@@ -0,0 +1,78 @@
+/*
+   Benchmark of the saving of the log in one file per channel:
+   wall time of Log::save on a full buffer of 300s at 1kHz
+   against the number of threads writing the channels.
+*/
+#include <time.h>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include "log.hh"
+
+using namespace rc_sot_system;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+static void fillLog(Log &log, unsigned int nbDofs, unsigned int nbSamples)
+{
+  DataToLog data;
+  data.init(nbDofs,1);
+  for(unsigned int k=0;k<nbSamples;k++)
+    {
+      for(unsigned int i=0;i<nbDofs;i++)
+	data.motor_angle[i] = data.joint_angle[i] = std::sin(1e-3*k+i);
+      log.record(data);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned int nbSamples = 300000, nbDofs = 32, nbRuns = 3;
+  std::string prefix("/tmp/bench-log-save");
+  if (argc>1)
+    nbSamples = (unsigned int)atoi(argv[1]);
+  if (argc>2)
+    nbDofs = (unsigned int)atoi(argv[2]);
+  if (argc>3)
+    prefix = argv[3];
+
+  Log log;
+  log.init(nbDofs,nbSamples);
+  fillLog(log,nbDofs,nbSamples);
+
+  // t, dt and the values of each channel for each sample.
+  const double mb = 1e-6*8*(double)nbSamples*
+    (5*(nbDofs+2) + 2*(3+2) + (24+2) + (nbDofs+2) + 2*(1+2) + (4+2));
+
+  const unsigned int nbThreads[5] = { 1, 2, 4, 6, 10 };
+  std::cout << "# threads best[ms] mean[ms] MB/s (" << mb << " MB)"
+	    << std::endl;
+  for(unsigned int k=0;k<5;k++)
+    {
+      log.setSaveThreads(nbThreads[k]);
+      double best = 1e9, total = 0.0;
+      for(unsigned int r=0;r<nbRuns;r++)
+	{
+	  double start = now();
+	  log.save(prefix);
+	  double elapsed = now()-start;
+	  best = std::min(best,elapsed);
+	  total += elapsed;
+	}
+      std::cout << std::setw(9) << nbThreads[k] << ' '
+		<< std::fixed << std::setprecision(1)
+		<< std::setw(8) << 1e3*best << ' '
+		<< std::setw(8) << 1e3*total/nbRuns << ' '
+		<< std::setw(6) << mb/best
+		<< std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,104 @@
+/*
+   Benchmark of the PD controller used in effort mode while the dynamic
+   graph is not running: one control_toolbox::Pid per joint against the
+   vectorized StandbyPDController.
+*/
+#include <time.h>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include "standby-pd-controller.hh"
+
+using namespace sot_controller;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+/// Returns the mean time of one control iteration in ns.
+static double benchPid(unsigned int nbJoints, unsigned int nbIterations)
+{
+  std::vector<control_toolbox::Pid> pids(nbJoints);
+  std::vector<double> position(nbJoints), velocity(nbJoints),
+    des_pos(nbJoints), command(nbJoints);
+  for(unsigned int i=0;i<nbJoints;i++)
+    {
+      pids[i].setGains(1000.0+i,10.0,5.0,20.0,-20.0);
+      des_pos[i] = 0.01*i;
+    }
+  ros::Duration period(0.001);
+
+  double start = now();
+  for(unsigned int it=0;it<nbIterations;it++)
+    {
+      for(unsigned int i=0;i<nbJoints;i++)
+	{
+	  position[i] = std::sin(1e-3*it+i);
+	  velocity[i] = std::cos(1e-3*it+i);
+	  command[i] = pids[i].computeCommand(des_pos[i]-position[i],
+					      -velocity[i],period);
+	}
+    }
+  double elapsed = now()-start;
+  if (command[0]!=command[0])
+    std::cerr << "Invalid command" << std::endl;
+  return 1e9*elapsed/nbIterations;
+}
+
+/// Returns the mean time of one control iteration in ns.
+static double benchVectorized(unsigned int nbJoints, unsigned int nbIterations)
+{
+  std::vector<control_toolbox::Pid> pids(nbJoints);
+  std::vector<double> command(nbJoints);
+  StandbyPDController pd;
+  pd.resize(nbJoints);
+  for(unsigned int i=0;i<nbJoints;i++)
+    {
+      pids[i].setGains(1000.0+i,10.0,5.0,20.0,-20.0);
+      pd.setGains(i,pids[i].getGains());
+      pd.setDesiredPosition(i,0.01*i);
+    }
+
+  double start = now();
+  for(unsigned int it=0;it<nbIterations;it++)
+    {
+      for(unsigned int i=0;i<nbJoints;i++)
+	pd.setState(i,std::sin(1e-3*it+i),std::cos(1e-3*it+i));
+      pd.computeCommand(0.001);
+      for(unsigned int i=0;i<nbJoints;i++)
+	command[i] = pd.command(i);
+    }
+  double elapsed = now()-start;
+  if (command[0]!=command[0])
+    std::cerr << "Invalid command" << std::endl;
+  return 1e9*elapsed/nbIterations;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned int nbIterations = 100000;
+  if (argc>1)
+    nbIterations = (unsigned int)atoi(argv[1]);
+
+  const unsigned int nbJoints[3] = { 12, 32, 64 };
+
+  std::cout << "# joints pid[ns/it] vectorized[ns/it] speedup" << std::endl;
+  for(unsigned int k=0;k<3;k++)
+    {
+      double tpid = benchPid(nbJoints[k],nbIterations);
+      double tvec = benchVectorized(nbJoints[k],nbIterations);
+      std::cout << std::setw(8) << nbJoints[k] << ' '
+		<< std::fixed << std::setprecision(1)
+		<< std::setw(11) << tpid << ' '
+		<< std::setw(17) << tvec << ' '
+		<< std::setprecision(2) << std::setw(7) << tpid/tvec
+		<< std::endl;
+    }
+  return 0;
+}
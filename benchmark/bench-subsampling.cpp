@@ -0,0 +1,149 @@
+/*
+   Long-run rate and phase error of the subsampling of the hardware loop:
+   the previous floating-point accumulator reset at each tick against
+   SubsamplingScheduler, alone and inside RCSotController::update() on
+   the mock robot (mock-robot-hw.hh), on the hardware loops of
+   subsampling-cases.hh.
+
+   The results are only reported: the rate and the phase of the
+   scheduler are checked by tests/test-subsampling-scheduler.cpp.
+   The controller is loaded with the stub SoT device and needs a
+   roscore: it is skipped without one.
+
+   Usage: roscontrol-sot-bench-subsampling [nbIterations]
+*/
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include <ros/ros.h>
+#include <std_srvs/Empty.h>
+
+#include "subsampling-cases.hh"
+#include "hot-path-controller.hh"
+
+using namespace sot_controller;
+
+static SubsamplingResult runFloat(const SubsamplingCase &c,
+				  unsigned int nbIterations)
+{
+  HardwareClock clock(c.hw,c.hw_jitter);
+  PhaseError phase(c.dt);
+  const double dtInSec = 1e-9*(double)c.dt, jitter = 1e-9*(double)c.jitter;
+  double accumulated_time = 0.0;
+  int64_t t = 0;
+  uint64_t ticks = 0;
+  for(unsigned int i=0;i<nbIterations;i++)
+    {
+      int64_t period = clock.next();
+      t += period;
+      double periodInSec = 1e-9*(double)period;
+      if (periodInSec+accumulated_time>dtInSec-jitter)
+	{
+	  phase.tick(t,ticks);
+	  ticks++;
+	  accumulated_time = 0.0;
+	}
+      else
+	accumulated_time += periodInSec;
+    }
+  SubsamplingResult result = { 1e9*(double)ticks/(double)t, phase.max() };
+  return result;
+}
+
+/// Same as runScheduler through the update() of the controller, with the
+/// dynamic graph started. Returns false if the controller cannot be run.
+static bool runController(const SubsamplingCase &c, unsigned int nbIterations,
+			  SubsamplingResult &result)
+{
+  MockRobotHW robot(12,1,0);
+  setControllerParams(robot,"POSITION",1e-9*(double)c.dt);
+  ros::param::set("/sot_controller/jitter",1e-9*(double)c.jitter);
+  HotPathController controller;
+  if (!controller.initOnMock(robot))
+    return false;
+
+  ros::Time time(0.0);
+  controller.starting(time);
+  std_srvs::Empty srv;
+  if (!ros::service::call("/start_dynamic_graph",srv))
+    return false;
+
+  HardwareClock clock(c.hw,c.hw_jitter);
+  PhaseError phase(c.dt);
+  const SubsamplingScheduler &scheduler = controller.scheduler();
+  int64_t t = 0;
+  for(unsigned int i=0;i<nbIterations;i++)
+    {
+      ros::Duration period;
+      period.fromNSec(clock.next());
+      t += period.toNSec();
+      time += period;
+      robot.read();
+      uint64_t ticks = scheduler.ticks();
+      controller.update(time,period);
+      if (scheduler.ticks()!=ticks)
+	phase.tick(t,scheduler.ticks()+scheduler.skipped()-1);
+    }
+  result.rate = scheduler.achievedRate();
+  result.phase_error = phase.max();
+  return true;
+}
+
+static std::string format(const SubsamplingResult &result)
+{
+  std::ostringstream oss;
+  oss << std::fixed << std::setprecision(2)
+      << std::setw(9) << result.rate << ' '
+      << std::setw(9) << result.phase_error;
+  return oss.str();
+}
+
+int main(int argc, char *argv[])
+{
+  ros::init(argc,argv,"roscontrol_sot_bench_subsampling");
+  unsigned int nbIterations = 1000000;
+  if (argc>1)
+    nbIterations = (unsigned int)atoi(argv[1]);
+
+  /// The controller runs a full iteration at each tick: fewer iterations.
+  bool withController = ros::master::check();
+  ros::AsyncSpinner spinner(1);
+  if (withController)
+    spinner.start();
+  else
+    std::cerr << "No roscore: the controller is skipped." << std::endl;
+
+  const SubsamplingCase *cases = SUBSAMPLING_CASES;
+  std::cout << "# hw[us] hw_jitter[us] dt[us] jitter[us] target[Hz]"
+	    << " float[Hz] phase[us] scheduler[Hz] phase[us]"
+	    << " controller[Hz] phase[us]"
+	    << std::endl;
+  for(unsigned int c=0;c<NB_SUBSAMPLING_CASES;c++)
+    {
+      SubsamplingResult rfloat = runFloat(cases[c],nbIterations);
+      SubsamplingResult rsched = runScheduler(cases[c],nbIterations);
+      std::string controller(" -");
+      if (withController)
+	{
+	  SubsamplingResult rcontroller;
+	  bool run = runController(cases[c],nbIterations/10+1,rcontroller);
+	  controller = run ? format(rcontroller) : std::string(" init failed");
+	}
+      std::cout << std::fixed << std::setprecision(1)
+		<< std::setw(7) << 1e-3*cases[c].hw << ' '
+		<< std::setw(6) << 1e-3*cases[c].hw_jitter << ' '
+		<< std::setw(6) << 1e-3*cases[c].dt << ' '
+		<< std::setw(6) << 1e-3*cases[c].jitter << ' '
+		<< std::setw(7) << 1e9/cases[c].dt << ' '
+		<< format(rfloat) << ' ' << format(rsched) << ' '
+		<< controller
+		<< std::endl;
+    }
+  if (withController)
+    spinner.stop();
+  return 0;
+}
@@ -0,0 +1,43 @@
+/*
+   RCSotController initialized on a mock robot (mock-robot-hw.hh), with
+   access to the protected steps of an iteration. Used by the
+   microbenchmarks and by the tests of the sensor-fill paths.
+*/
+
+#ifndef _RC_SOT_BENCHMARK_HOT_PATH_CONTROLLER_H_
+#define _RC_SOT_BENCHMARK_HOT_PATH_CONTROLLER_H_
+
+#include <vector>
+
+#include <ros/ros.h>
+
+#include "roscontrol-sot-controller.hh"
+#include "mock-robot-hw.hh"
+
+/// Gives access to the protected steps of an iteration.
+class HotPathController : public sot_controller::RCSotController
+{
+public:
+  bool initOnMock(MockRobotHW &robot)
+  {
+    ros::NodeHandle robot_nh, controller_nh("sot_controller");
+#ifdef CONTROLLER_INTERFACE_KINETIC
+    controller_interface::ControllerBase::ClaimedResources claimed_resources;
+#else
+    sot_controller::ClaimedResources claimed_resources;
+#endif
+    if (!initRequest(&robot,robot_nh,controller_nh,claimed_resources))
+      return false;
+    /// Output of the SoT device read by readControl.
+    controlValues_["control"].setValues(std::vector<double>(nbDofs_,0.1));
+    return true;
+  }
+  void benchFillJoints() { fillJoints(); }
+  void benchFillImu() { fillImu(); }
+  void benchFillForceSensors() { fillForceSensors(); }
+  void benchReadControl() { readControl(); }
+  const sot_controller::SubsamplingScheduler & scheduler() const
+  { return sotScheduler(); }
+};
+
+#endif /* _RC_SOT_BENCHMARK_HOT_PATH_CONTROLLER_H_ */
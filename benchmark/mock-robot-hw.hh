@@ -0,0 +1,161 @@
+/*
+   Robot without hardware for the benchmarks of RCSotController:
+   a RobotHW exposing joints, IMUs and force sensors backed by plain
+   vectors, and the parameters loading the controller on it with the
+   stub SoT device (stub-sot-device.cpp).
+*/
+
+#ifndef _RC_SOT_BENCHMARK_MOCK_ROBOT_HW_H_
+#define _RC_SOT_BENCHMARK_MOCK_ROBOT_HW_H_
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <hardware_interface/robot_hw.h>
+#include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/imu_sensor_interface.h>
+#include <hardware_interface/force_torque_sensor_interface.h>
+
+#ifndef STUB_SOT_DEVICE
+#define STUB_SOT_DEVICE "libroscontrol-sot-stub-device.so"
+#endif
+
+namespace hi = hardware_interface;
+
+/// Robot without hardware: the command of a joint becomes its position.
+class MockRobotHW : public hi::RobotHW
+{
+public:
+  MockRobotHW(unsigned int nbJoints, unsigned int nbImus,
+	      unsigned int nbForceSensors):
+    position_(nbJoints,0.0),
+    velocity_(nbJoints,0.0),
+    effort_(nbJoints,0.0),
+    command_(nbJoints,0.0),
+    imu_(10*nbImus,0.0),
+    ft_(6*nbForceSensors,0.0)
+  {
+    /// The handles keep pointers to the vectors: they are not resized.
+    for(unsigned int i=0;i<nbJoints;i++)
+      {
+	std::ostringstream name;
+	name << "joint_" << i;
+	joint_names.push_back(name.str());
+	hi::JointStateHandle state(name.str(),&position_[i],
+				   &velocity_[i],&effort_[i]);
+	js_iface_.registerHandle(state);
+	pos_iface_.registerHandle(hi::JointHandle(state,&command_[i]));
+	effort_iface_.registerHandle(hi::JointHandle(state,&command_[i]));
+      }
+
+    for(unsigned int i=0;i<nbImus;i++)
+      {
+	std::ostringstream name;
+	name << "imu_" << i;
+	double *imu = &imu_[10*i];
+	imu[3] = 1.0;
+	imu[9] = 9.81;
+	hi::ImuSensorHandle::Data data;
+	data.name = name.str();
+	data.frame_id = name.str();
+	data.orientation = imu;
+	data.angular_velocity = imu+4;
+	data.linear_acceleration = imu+7;
+	imu_iface_.registerHandle(hi::ImuSensorHandle(data));
+      }
+
+    for(unsigned int i=0;i<nbForceSensors;i++)
+      {
+	std::ostringstream name;
+	name << "ft_" << i;
+	ft_[6*i+2] = 400.0;
+	ft_iface_.registerHandle
+	  (hi::ForceTorqueSensorHandle(name.str(),name.str(),
+				       &ft_[6*i],&ft_[6*i+3]));
+      }
+
+    registerInterface(&js_iface_);
+    registerInterface(&pos_iface_);
+    registerInterface(&effort_iface_);
+    registerInterface(&imu_iface_);
+    registerInterface(&ft_iface_);
+  }
+
+  /// Apply the command as a position servo would.
+  void read()
+  {
+    for(std::size_t i=0;i<position_.size();i++)
+      {
+	velocity_[i] = command_[i]-position_[i];
+	position_[i] = command_[i];
+      }
+  }
+
+  std::vector<std::string> joint_names;
+
+private:
+  hi::JointStateInterface js_iface_;
+  hi::PositionJointInterface pos_iface_;
+  hi::EffortJointInterface effort_iface_;
+  hi::ImuSensorInterface imu_iface_;
+  hi::ForceTorqueSensorInterface ft_iface_;
+  std::vector<double> position_, velocity_, effort_, command_;
+  /// Orientation (4), angular velocity (3), linear acceleration (3).
+  std::vector<double> imu_;
+  /// Force (3) and torque (3).
+  std::vector<double> ft_;
+};
+
+/// Serial chain of revolute joints carrying the names of the mock robot.
+inline std::string makeUrdf(const std::vector<std::string> &jointNames)
+{
+  std::ostringstream urdf;
+  urdf << "<robot name=\"bench\">\n<link name=\"link_0\"/>\n";
+  for(std::size_t i=0;i<jointNames.size();i++)
+    urdf << "<link name=\"link_" << i+1 << "\"/>\n"
+	 << "<joint name=\"" << jointNames[i] << "\" type=\"revolute\">\n"
+	 << "  <parent link=\"link_" << i << "\"/>\n"
+	 << "  <child link=\"link_" << i+1 << "\"/>\n"
+	 << "  <axis xyz=\"0 0 1\"/>\n"
+	 << "  <limit lower=\"-3\" upper=\"3\" effort=\"100\" velocity=\"10\"/>\n"
+	 << "</joint>\n";
+  urdf << "</robot>\n";
+  return urdf.str();
+}
+
+inline void setControllerParams(const MockRobotHW &robot, const std::string &controlMode,
+		      double dt)
+{
+  ros::param::set("/robot_description",makeUrdf(robot.joint_names));
+  ros::param::set("/sot_controller/libname",std::string(STUB_SOT_DEVICE));
+  ros::param::set("/sot_controller/simulation_mode",true);
+  ros::param::set("/sot_controller/joint_names",robot.joint_names);
+  ros::param::set("/sot_controller/control_mode",controlMode);
+  ros::param::set("/sot_controller/dt",dt);
+
+  std::map<std::string,std::string> mapping;
+  mapping["motor-angles"] = "motor-angles";
+  mapping["joint-angles"] = "joint-angles";
+  mapping["velocities"] = "velocities";
+  mapping["torques"] = "torques";
+  mapping["currents"] = "currents";
+  mapping["forces"] = "forces";
+  mapping["cmd-joints"] = "control";
+  mapping["cmd-effort"] = "control";
+  ros::param::set("/sot_controller/map_rc_to_sot_device",mapping);
+
+  for(std::size_t i=0;i<robot.joint_names.size();i++)
+    {
+      std::string prefix = "/sot_controller/effort_control_pd_motor_init/gains/"
+	+ robot.joint_names[i];
+      ros::param::set(prefix+"/p",100.0);
+      ros::param::set(prefix+"/d",1.0);
+      ros::param::set(prefix+"/i",0.0);
+    }
+}
+
+#endif /* _RC_SOT_BENCHMARK_MOCK_ROBOT_HW_H_ */
@@ -0,0 +1,63 @@
+/*
+   Minimal SoT device used by roscontrol-sot-bench-controller: it keeps
+   the robot at its current position by copying the motor angles into
+   the control. It costs next to nothing, so the benchmark measures the
+   controller and not the dynamic graph.
+*/
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sot/core/abstract-sot-external-interface.hh>
+
+namespace dgs = dynamicgraph::sot;
+
+class StubSotDevice : public dgs::AbstractSotExternalInterface
+{
+public:
+  StubSotDevice() {}
+  virtual ~StubSotDevice() {}
+
+  virtual void setupSetSensors(std::map<std::string,dgs::SensorValues> &sensorsIn)
+  {
+    nominalSetSensors(sensorsIn);
+  }
+
+  virtual void nominalSetSensors(std::map<std::string,dgs::SensorValues> &sensorsIn)
+  {
+    std::map<std::string,dgs::SensorValues>::iterator it =
+      sensorsIn.find("motor-angles");
+    if (it!=sensorsIn.end())
+      state_ = it->second.getValues();
+  }
+
+  virtual void cleanupSetSensors(std::map<std::string,dgs::SensorValues> &sensorsIn)
+  {
+    nominalSetSensors(sensorsIn);
+  }
+
+  virtual void getControl(std::map<std::string,dgs::ControlValues> &controlOut)
+  {
+    controlOut["control"].setValues(state_);
+  }
+
+  virtual void setSecondOrderIntegration() {}
+  virtual void setNoIntegration() {}
+
+private:
+  /// Last motor angles, sent back as the control.
+  std::vector<double> state_;
+};
+
+extern "C"
+{
+  dgs::AbstractSotExternalInterface * createSotExternalInterface()
+  {
+    return new StubSotDevice;
+  }
+
+  void destroySotExternalInterface(dgs::AbstractSotExternalInterface *p)
+  {
+    delete p;
+  }
+}
@@ -0,0 +1,116 @@
+/*
+   Hardware loops subsampled at the SoT period, shared by the benchmark
+   of the subsampling and the test of SubsamplingScheduler.
+
+   The hardware wakes up on the grid of its period, each wake-up being
+   delayed or advanced by a uniform jitter, as a periodic real-time loop.
+   The phase error is measured against the grid of the SoT period.
+*/
+
+#ifndef _RC_SOT_BENCHMARK_SUBSAMPLING_CASES_H_
+#define _RC_SOT_BENCHMARK_SUBSAMPLING_CASES_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "subsampling-scheduler.hh"
+
+/// Hardware period, jitter of its wake-ups, SoT period and jitter
+/// configured in the scheduler, in ns.
+struct SubsamplingCase
+{
+  int64_t hw, hw_jitter, dt, jitter;
+};
+
+/// The last case has a configured jitter larger than the gap between
+/// the ratios 2 and 3: it must not be taken as a decimation.
+static const unsigned int NB_SUBSAMPLING_CASES = 6;
+static const SubsamplingCase SUBSAMPLING_CASES[NB_SUBSAMPLING_CASES] =
+  { { 1000000, 0, 1000000, 0 },
+    { 1000000, 50000, 1000000, 50000 },
+    { 1000000, 50000, 2000000, 50000 },
+    { 400000, 0, 1000000, 0 },
+    { 300000, 20000, 1000000, 20000 },
+    { 400000, 0, 1000000, 250000 } };
+
+struct SubsamplingResult
+{
+  double rate;
+  // Largest distance in us between a tick and the ideal grid.
+  double phase_error;
+};
+
+/// Wake-ups of the hardware loop on the grid of its period with a
+/// uniform jitter. The sequence is the same for each run.
+class HardwareClock
+{
+public:
+  HardwareClock(int64_t period, int64_t jitter):
+    period_(period), jitter_(jitter), rank_(0), last_(0)
+  {
+    srand(1);
+  }
+
+  /// Time in ns since the previous wake-up.
+  int64_t next()
+  {
+    rank_++;
+    int64_t t = rank_*period_;
+    if (jitter_>0)
+      t += (rand()%(2*jitter_+1)) - jitter_;
+    int64_t period = t - last_;
+    last_ = t;
+    return period;
+  }
+
+private:
+  int64_t period_, jitter_, rank_, last_;
+};
+
+/// Largest phase error of the ticks on the grid of period dt starting
+/// at the first tick.
+class PhaseError
+{
+public:
+  PhaseError(int64_t dt): dt_(dt), t0_(-1), max_(0.0) {}
+
+  /// Tick of rank k at time t.
+  void tick(int64_t t, uint64_t k)
+  {
+    if (t0_<0)
+      t0_ = t;
+    max_ = std::max(max_,1e-3*std::fabs((double)(t - t0_ - (int64_t)k*dt_)));
+  }
+
+  double max() const { return max_; }
+
+private:
+  int64_t dt_, t0_;
+  double max_;
+};
+
+/// Rate and phase error of SubsamplingScheduler over nbIterations
+/// hardware iterations.
+inline SubsamplingResult runScheduler(const SubsamplingCase &c,
+				      unsigned int nbIterations)
+{
+  HardwareClock clock(c.hw,c.hw_jitter);
+  PhaseError phase(c.dt);
+  sot_controller::SubsamplingScheduler scheduler;
+  scheduler.setPeriod(c.dt,c.jitter);
+  int64_t t = 0;
+  for(unsigned int i=0;i<nbIterations;i++)
+    {
+      int64_t period = clock.next();
+      t += period;
+      if (scheduler.update(period))
+	// The skipped periods are part of the grid.
+	phase.tick(t,scheduler.ticks()+scheduler.skipped()-1);
+    }
+  SubsamplingResult result = { scheduler.achievedRate(), phase.max() };
+  return result;
+}
+
+#endif /* _RC_SOT_BENCHMARK_SUBSAMPLING_CASES_H_ */
@@ -0,0 +1,144 @@
+/*
+   Detection of the iterations of the control loop missing their deadline.
+*/
+#include "deadline-monitor.hh"
+
+#include <sstream>
+#include <iomanip>
+
+namespace sot_controller
+{
+  DeadlineMiss::DeadlineMiss():
+    time(0), excess(0), kind(OVERRUN)
+  {
+  }
+
+  DeadlineStats::DeadlineStats():
+    iterations(0), overruns(0), late(0), worker_misses(0),
+    worst_overrun(0), worst_lateness(0),
+    nb_last_misses(0)
+  {
+  }
+
+  std::string DeadlineStats::str(int64_t origin) const
+  {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1)
+	<< iterations << " iterations, "
+	<< overruns << " overruns (worst +" << 1e-3*(double)worst_overrun
+	<< "us), " << late << " late (worst +"
+	<< 1e-3*(double)worst_lateness << "us), "
+	<< worker_misses << " worker misses";
+    for(unsigned int i=0;i<nb_last_misses;i++)
+      {
+	const DeadlineMiss &miss = last_misses[i];
+	oss << "\n  " << std::setprecision(6)
+	    << 1e-9*(double)(miss.time-origin) << "s ";
+	if (miss.kind==DeadlineMiss::WORKER)
+	  {
+	    oss << "worker miss";
+	    continue;
+	  }
+	oss << (miss.kind==DeadlineMiss::OVERRUN ? "overrun" : "late")
+	    << " +" << std::setprecision(1) << 1e-3*(double)miss.excess << "us";
+      }
+    return oss.str();
+  }
+
+  DeadlineMonitor::DeadlineMonitor():
+    period_(0),
+    tolerance_(0),
+    last_start_(0),
+    next_miss_(0),
+    sequence_(0)
+  {
+  }
+
+  void DeadlineMonitor::setDeadline(int64_t period, int64_t tolerance)
+  {
+    period_ = period;
+    tolerance_ = tolerance;
+  }
+
+  void DeadlineMonitor::reset()
+  {
+    sequence_.fetch_add(1,boost::memory_order_acq_rel);
+    stats_ = DeadlineStats();
+    last_start_ = 0;
+    next_miss_ = 0;
+    sequence_.fetch_add(1,boost::memory_order_release);
+  }
+
+  void DeadlineMonitor::addMiss(int64_t time, int64_t excess,
+				DeadlineMiss::Kind kind)
+  {
+    DeadlineMiss &miss = stats_.last_misses[next_miss_];
+    miss.time = time;
+    miss.excess = excess;
+    miss.kind = kind;
+    next_miss_ = (next_miss_+1)%DeadlineStats::NB_LAST_MISSES;
+    if (stats_.nb_last_misses<DeadlineStats::NB_LAST_MISSES)
+      stats_.nb_last_misses++;
+  }
+
+  void DeadlineMonitor::check(int64_t start, int64_t duration,
+			      int64_t spread)
+  {
+    if (period_<=0)
+      return;
+
+    sequence_.fetch_add(1,boost::memory_order_acq_rel);
+    stats_.iterations++;
+    if (duration>period_)
+      {
+	int64_t excess = duration-period_;
+	stats_.overruns++;
+	if (excess>stats_.worst_overrun)
+	  stats_.worst_overrun = excess;
+	addMiss(start,excess,DeadlineMiss::OVERRUN);
+      }
+    if (last_start_>0 && start-last_start_>period_+tolerance_+spread)
+      {
+	int64_t excess = start-last_start_-period_;
+	stats_.late++;
+	if (excess>stats_.worst_lateness)
+	  stats_.worst_lateness = excess;
+	addMiss(start,excess,DeadlineMiss::LATE);
+      }
+    last_start_ = start;
+    sequence_.fetch_add(1,boost::memory_order_release);
+  }
+
+  void DeadlineMonitor::workerMiss(int64_t start)
+  {
+    sequence_.fetch_add(1,boost::memory_order_acq_rel);
+    stats_.worker_misses++;
+    addMiss(start,0,DeadlineMiss::WORKER);
+    sequence_.fetch_add(1,boost::memory_order_release);
+  }
+
+  void DeadlineMonitor::stats(DeadlineStats &stats) const
+  {
+    // Copy until no update happened during the copy.
+    uint32_t before, after;
+    unsigned int first;
+    do
+      {
+	before = sequence_.load(boost::memory_order_acquire);
+	stats = stats_;
+	first = next_miss_;
+	boost::atomic_thread_fence(boost::memory_order_acquire);
+	after = sequence_.load(boost::memory_order_relaxed);
+      }
+    while ((before & 1) || before!=after);
+
+    // Put the oldest miss first.
+    if (stats.nb_last_misses==DeadlineStats::NB_LAST_MISSES && first>0)
+      {
+	DeadlineStats copy = stats;
+	for(unsigned int i=0;i<DeadlineStats::NB_LAST_MISSES;i++)
+	  stats.last_misses[i] =
+	    copy.last_misses[(first+i)%DeadlineStats::NB_LAST_MISSES];
+      }
+  }
+}
@@ -0,0 +1,96 @@
+/*
+   Detection of the iterations of the control loop missing their deadline.
+*/
+
+#ifndef _RC_SOT_DEADLINE_MONITOR_H_
+#define _RC_SOT_DEADLINE_MONITOR_H_
+
+#include <stdint.h>
+#include <string>
+
+#include <boost/atomic.hpp>
+
+namespace sot_controller
+{
+  /// \brief One missed deadline.
+  struct DeadlineMiss
+  {
+    enum Kind { OVERRUN, LATE, WORKER };
+
+    /// Monotonic time in ns of the start of the iteration.
+    int64_t time;
+    /// Time in ns beyond the deadline, 0 for a worker miss.
+    int64_t excess;
+    Kind kind;
+
+    DeadlineMiss();
+  };
+
+  /// \brief Counters of the missed deadlines.
+  struct DeadlineStats
+  {
+    static const unsigned int NB_LAST_MISSES = 16;
+
+    uint64_t iterations;
+    /// Iterations lasting longer than the period.
+    uint64_t overruns;
+    /// Iterations starting later than the period plus the tolerance
+    /// after the previous one.
+    uint64_t late;
+    /// Iterations applying the previous command again because the
+    /// SoT worker was still busy (pipelined evaluation).
+    uint64_t worker_misses;
+    int64_t worst_overrun;
+    int64_t worst_lateness;
+    /// Last missed deadlines, the oldest first.
+    unsigned int nb_last_misses;
+    DeadlineMiss last_misses[NB_LAST_MISSES];
+
+    DeadlineStats();
+
+    /// \brief Human readable dump. The times of the misses are given
+    /// in seconds since origin.
+    std::string str(int64_t origin) const;
+  };
+
+  /// \brief Check the period and the duration of each iteration.
+  /// check() is called by the real-time thread and does not allocate,
+  /// stats() can be called from any other thread.
+  class DeadlineMonitor
+  {
+  public:
+    DeadlineMonitor();
+
+    /// \brief Period and tolerance on the start of an iteration, in ns.
+    void setDeadline(int64_t period, int64_t tolerance);
+
+    /// \brief Clear the counters. Same thread as check().
+    void reset();
+
+    /// \brief Check one iteration starting at start and lasting duration.
+    /// spread is added to the tolerance of this iteration: when the SoT
+    /// period is not a multiple of the hardware period, two iterations
+    /// are up to one hardware period further apart than the SoT period.
+    void check(int64_t start, int64_t duration, int64_t spread=0);
+
+    /// \brief Count an iteration starting at start where the SoT
+    /// worker was still busy. Same thread as check().
+    void workerMiss(int64_t start);
+
+    /// \brief Consistent copy of the counters.
+    void stats(DeadlineStats &stats) const;
+
+  private:
+    void addMiss(int64_t time, int64_t excess, DeadlineMiss::Kind kind);
+
+    int64_t period_, tolerance_;
+    int64_t last_start_;
+    // Index of the next entry of stats_.last_misses.
+    unsigned int next_miss_;
+    DeadlineStats stats_;
+    // Odd while check() updates stats_.
+    boost::atomic<uint32_t> sequence_;
+  };
+}
+
+#endif /* _RC_SOT_DEADLINE_MONITOR_H_ */
@@ -0,0 +1,84 @@
+/*
+   Histogram of latencies filled by the real-time loop and read
+   by other threads.
+*/
+#include "latency-histogram.hh"
+
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+namespace sot_controller
+{
+  LatencySummary::LatencySummary():
+    count(0), p50(0), p99(0), p999(0), max(0)
+  {
+  }
+
+  std::string LatencySummary::str() const
+  {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1)
+	<< "n=" << count
+	<< " p50=" << 1e-3*(double)p50
+	<< "us p99=" << 1e-3*(double)p99
+	<< "us p99.9=" << 1e-3*(double)p999
+	<< "us max=" << 1e-3*(double)max << "us";
+    return oss.str();
+  }
+
+  LatencyHistogram::LatencyHistogram()
+  {
+    reset();
+  }
+
+  void LatencyHistogram::reset()
+  {
+    for(unsigned int i=0;i<NB_BUCKETS;i++)
+      counts_[i].store(0,boost::memory_order_relaxed);
+    max_.store(0,boost::memory_order_relaxed);
+    count_.store(0,boost::memory_order_release);
+  }
+
+  int64_t LatencyHistogram::bucketValue(unsigned int index)
+  {
+    if (index<(1u<<SUB_BITS))
+      return index;
+    unsigned int shift = (index>>SUB_BITS)-1;
+    uint64_t top = (index & ((1u<<SUB_BITS)-1)) + (1u<<SUB_BITS);
+    return (int64_t)(((top+1)<<shift)-1);
+  }
+
+  void LatencyHistogram::summary(LatencySummary &summary) const
+  {
+    // The buckets are read after the count: the snapshot may hold a few
+    // more values than count, never less.
+    summary = LatencySummary();
+    summary.count = count_.load(boost::memory_order_acquire);
+    summary.max = max_.load(boost::memory_order_relaxed);
+    if (summary.count==0)
+      return;
+
+    const uint64_t rank50 = (summary.count*500+999)/1000,
+      rank99 = (summary.count*990+999)/1000,
+      rank999 = (summary.count*999+999)/1000;
+    uint64_t cumulated = 0;
+    for(unsigned int i=0;i<NB_BUCKETS;i++)
+      {
+	uint64_t n = counts_[i].load(boost::memory_order_relaxed);
+	if (n==0)
+	  continue;
+	int64_t value = std::min(bucketValue(i),summary.max);
+	if (cumulated<rank50 && cumulated+n>=rank50)
+	  summary.p50 = value;
+	if (cumulated<rank99 && cumulated+n>=rank99)
+	  summary.p99 = value;
+	if (cumulated<rank999 && cumulated+n>=rank999)
+	  {
+	    summary.p999 = value;
+	    break;
+	  }
+	cumulated += n;
+      }
+  }
+}
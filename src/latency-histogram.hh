@@ -0,0 +1,80 @@
+/*
+   Histogram of latencies filled by the real-time loop and read
+   by other threads.
+*/
+
+#ifndef _RC_SOT_LATENCY_HISTOGRAM_H_
+#define _RC_SOT_LATENCY_HISTOGRAM_H_
+
+#include <stdint.h>
+#include <string>
+
+#include <boost/atomic.hpp>
+
+namespace sot_controller
+{
+  /// \brief Summary of a LatencyHistogram, in ns.
+  struct LatencySummary
+  {
+    uint64_t count;
+    int64_t p50, p99, p999, max;
+
+    LatencySummary();
+
+    /// \brief Human readable summary, in microseconds.
+    std::string str() const;
+  };
+
+  /// \brief HDR-style histogram of latencies in ns.
+  /// The buckets are exact below 2^SUB_BITS ns, then each power of 2
+  /// is split in 2^SUB_BITS buckets: the relative error is below 2^-SUB_BITS.
+  /// record() is wait-free and must be called by a single thread,
+  /// summary() can be called concurrently from any thread.
+  class LatencyHistogram
+  {
+  public:
+    static const unsigned int SUB_BITS = 5;
+    static const unsigned int NB_BUCKETS = (64-SUB_BITS)<<SUB_BITS;
+
+    LatencyHistogram();
+
+    /// \brief Add a latency. Negative values are counted as 0.
+    void record(int64_t ns)
+    {
+      uint64_t value = ns>0 ? (uint64_t)ns : 0;
+      boost::atomic<uint32_t> &bucket = counts_[bucketIndex(value)];
+      bucket.store(bucket.load(boost::memory_order_relaxed)+1,
+		   boost::memory_order_relaxed);
+      if ((int64_t)value>max_.load(boost::memory_order_relaxed))
+	max_.store((int64_t)value,boost::memory_order_relaxed);
+      count_.store(count_.load(boost::memory_order_relaxed)+1,
+		   boost::memory_order_release);
+    }
+
+    /// \brief Clear the histogram. Same thread as record().
+    void reset();
+
+    /// \brief Compute the percentiles from a snapshot of the buckets.
+    /// A percentile is the highest value of its bucket.
+    void summary(LatencySummary &summary) const;
+
+    static unsigned int bucketIndex(uint64_t value)
+    {
+      if (value<(1u<<SUB_BITS))
+	return (unsigned int)value;
+      unsigned int shift = 63-__builtin_clzll(value)-SUB_BITS;
+      return ((shift+1)<<SUB_BITS) + (unsigned int)(value>>shift)
+	- (1u<<SUB_BITS);
+    }
+
+    /// \brief Highest value counted in a bucket.
+    static int64_t bucketValue(unsigned int index);
+
+  private:
+    boost::atomic<uint32_t> counts_[NB_BUCKETS];
+    boost::atomic<uint64_t> count_;
+    boost::atomic<int64_t> max_;
+  };
+}
+
+#endif /* _RC_SOT_LATENCY_HISTOGRAM_H_ */
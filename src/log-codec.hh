@@ -0,0 +1,167 @@
+/*
+   Lossless compression of the columns of the log container.
+
+   Each value is XORed with the previous one of the same column
+   (Gorilla encoding). Slowly varying signals give XORs with many leading
+   and trailing zeros, which are not stored:
+     '0'                   same value as the previous one,
+     '10' + bits           meaningful bits in the same window as before,
+     '11' + 6 bits leading zeros + 6 bits (length-1) + bits.
+   The first value is stored on 64 bits.
+*/
+
+#ifndef _RC_SOT_SYSTEM_LOG_CODEC_H_
+#define _RC_SOT_SYSTEM_LOG_CODEC_H_
+
+#include <stdint.h>
+#include <cstring>
+#include <vector>
+
+namespace rc_sot_system {
+
+  /// Append bits, most significant first, to a byte buffer.
+  class LogBitWriter
+  {
+  public:
+    LogBitWriter(std::vector<unsigned char> &out):
+      out_(out), acc_(0), nbits_(0) {}
+
+    /// Write the n (<=64) lowest bits of value.
+    void write(uint64_t value, unsigned int n)
+    {
+      if (n>32)
+	{
+	  write(value>>32,n-32);
+	  n = 32;
+	}
+      acc_ = (acc_<<n) | (value & ((1ULL<<n)-1));
+      nbits_ += n;
+      while (nbits_>=8)
+	{
+	  nbits_ -= 8;
+	  out_.push_back((unsigned char)(acc_>>nbits_));
+	}
+      acc_ &= (1ULL<<nbits_)-1;
+    }
+
+    /// Write the last incomplete byte.
+    void flush()
+    {
+      if (nbits_>0)
+	out_.push_back((unsigned char)(acc_<<(8-nbits_)));
+      acc_ = 0;
+      nbits_ = 0;
+    }
+
+  private:
+    std::vector<unsigned char> &out_;
+    uint64_t acc_;
+    unsigned int nbits_;
+  };
+
+  /// Read bits written by LogBitWriter.
+  class LogBitReader
+  {
+  public:
+    LogBitReader(const unsigned char *data, std::size_t size):
+      data_(data), size_(size), pos_(0), acc_(0), nbits_(0) {}
+
+    /// Read n (<=64) bits.
+    uint64_t read(unsigned int n)
+    {
+      if (n>32)
+	{
+	  uint64_t high = read(n-32);
+	  return (high<<32) | read(32);
+	}
+      while (nbits_<n)
+	{
+	  acc_ = (acc_<<8) | (pos_<size_ ? data_[pos_++] : 0);
+	  nbits_ += 8;
+	}
+      nbits_ -= n;
+      uint64_t value = (acc_>>nbits_) & ((1ULL<<n)-1);
+      acc_ &= (1ULL<<nbits_)-1;
+      return value;
+    }
+
+  private:
+    const unsigned char *data_;
+    std::size_t size_, pos_;
+    uint64_t acc_;
+    unsigned int nbits_;
+  };
+
+  /// Compress n values and append them to out.
+  inline void encodeLogColumn(const double *values, std::size_t n,
+			      std::vector<unsigned char> &out)
+  {
+    if (n==0)
+      return;
+    LogBitWriter writer(out);
+    uint64_t prev;
+    memcpy(&prev,values,sizeof(prev));
+    writer.write(prev,64);
+
+    unsigned int prevLead = 65, prevTrail = 0;
+    for(std::size_t i=1;i<n;i++)
+      {
+	uint64_t cur;
+	memcpy(&cur,values+i,sizeof(cur));
+	uint64_t x = cur ^ prev;
+	prev = cur;
+	if (x==0)
+	  {
+	    writer.write(0,1);
+	    continue;
+	  }
+	unsigned int lead = __builtin_clzll(x);
+	unsigned int trail = __builtin_ctzll(x);
+	if (prevLead<=lead && prevTrail<=trail)
+	  {
+	    writer.write(2,2);
+	    writer.write(x>>prevTrail,64-prevLead-prevTrail);
+	  }
+	else
+	  {
+	    unsigned int meaningful = 64-lead-trail;
+	    writer.write(3,2);
+	    writer.write(lead,6);
+	    writer.write(meaningful-1,6);
+	    writer.write(x>>trail,meaningful);
+	    prevLead = lead;
+	    prevTrail = trail;
+	  }
+      }
+    writer.flush();
+  }
+
+  /// Decompress n values written by encodeLogColumn.
+  inline void decodeLogColumn(const unsigned char *data, std::size_t size,
+			      std::size_t n, double *values)
+  {
+    if (n==0)
+      return;
+    LogBitReader reader(data,size);
+    uint64_t prev = reader.read(64);
+    memcpy(values,&prev,sizeof(prev));
+
+    unsigned int prevLead = 0, prevTrail = 0;
+    for(std::size_t i=1;i<n;i++)
+      {
+	if (reader.read(1)!=0)
+	  {
+	    if (reader.read(1)!=0)
+	      {
+		prevLead = (unsigned int)reader.read(6);
+		unsigned int meaningful = (unsigned int)reader.read(6)+1;
+		prevTrail = 64-prevLead-meaningful;
+	      }
+	    prev ^= reader.read(64-prevLead-prevTrail) << prevTrail;
+	  }
+	memcpy(values+i,&prev,sizeof(prev));
+      }
+  }
+}
+
+#endif /* _RC_SOT_SYSTEM_LOG_CODEC_H_ */
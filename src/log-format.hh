@@ -0,0 +1,199 @@
+/*
+   Layout of the single-file log container written by rc_sot_system::Log
+   and read by roscontrol-sot-parse-log.
+
+   The file starts with a header:
+     char     magic[8]       "RCSOTLG1"
+     uint32   version
+     uint32   nbChannels
+     uint64   nbSamples
+     uint64   nbDropped      samples missing from the log (version 2)
+   followed by the description of each channel:
+     string   name
+     string   unit
+     uint32   type           LOG_TYPE_*
+     uint32   nbColumns
+     string   column names   (nbColumns times)
+     uint64   offset         position of the first column in the file
+     uint64   stride         bytes between two consecutive columns
+   where a string is a uint32 length followed by the characters.
+
+   The data are stored column by column: the nbSamples values of a column
+   are contiguous and each column starts on a LOG_ALIGNMENT boundary.
+   The first channel is the time base shared by all the others.
+   nbDropped counts the samples not recorded because the log was being
+   saved, since the log was initialized: the time base has a gap there.
+   Version 1 has no nbDropped and is still read.
+
+   The columns of a LOG_TYPE_DOUBLE_XOR channel are compressed
+   (see log-codec.hh) and have variable sizes: offset points to a table
+   of nbColumns pairs of uint64 (position in the file, size in bytes),
+   and stride is 0.
+*/
+
+#ifndef _RC_SOT_SYSTEM_LOG_FORMAT_H_
+#define _RC_SOT_SYSTEM_LOG_FORMAT_H_
+
+#include <stdint.h>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace rc_sot_system {
+
+  static const char LOG_MAGIC[8] = { 'R','C','S','O','T','L','G','1' };
+  static const uint32_t LOG_VERSION = 2;
+  static const uint64_t LOG_ALIGNMENT = 64;
+
+  /// Type of the values of a channel.
+  enum LogType { LOG_TYPE_DOUBLE = 0, LOG_TYPE_DOUBLE_XOR = 1 };
+
+  /// Description of one channel of the container.
+  struct LogChannelHeader
+  {
+    std::string name;
+    std::string unit;
+    uint32_t type;
+    std::vector<std::string> columns;
+    uint64_t offset;
+    uint64_t stride;
+
+    LogChannelHeader(): type(LOG_TYPE_DOUBLE), offset(0), stride(0) {}
+  };
+
+  /// Header of the container.
+  struct LogHeader
+  {
+    uint64_t nbSamples;
+    uint64_t nbDropped;
+    std::vector<LogChannelHeader> channels;
+
+    LogHeader(): nbSamples(0), nbDropped(0) {}
+  };
+
+  inline uint64_t alignLogOffset(uint64_t offset)
+  {
+    return (offset + LOG_ALIGNMENT - 1) / LOG_ALIGNMENT * LOG_ALIGNMENT;
+  }
+
+  template<typename T>
+  inline void writeLogValue(std::ostream &os, const T &value)
+  {
+    os.write((const char*)&value, sizeof(T));
+  }
+
+  inline void writeLogString(std::ostream &os, const std::string &str)
+  {
+    writeLogValue(os,(uint32_t)str.size());
+    os.write(str.data(), str.size());
+  }
+
+  template<typename T>
+  inline bool readLogValue(std::istream &is, T &value)
+  {
+    is.read((char*)&value, sizeof(T));
+    return is.good();
+  }
+
+  inline bool readLogString(std::istream &is, std::string &str)
+  {
+    uint32_t size;
+    if (!readLogValue(is,size))
+      return false;
+    str.resize(size);
+    if (size>0)
+      is.read(&str[0], size);
+    return is.good();
+  }
+
+  /// Write the header. The offsets and strides of the channels have to be
+  /// set: their size does not depend on their value.
+  inline void writeLogHeader(std::ostream &os, const LogHeader &header)
+  {
+    os.write(LOG_MAGIC, sizeof(LOG_MAGIC));
+    writeLogValue(os,LOG_VERSION);
+    writeLogValue(os,(uint32_t)header.channels.size());
+    writeLogValue(os,header.nbSamples);
+    writeLogValue(os,header.nbDropped);
+    for(std::size_t i=0;i<header.channels.size();i++)
+      {
+	const LogChannelHeader &channel = header.channels[i];
+	writeLogString(os,channel.name);
+	writeLogString(os,channel.unit);
+	writeLogValue(os,channel.type);
+	writeLogValue(os,(uint32_t)channel.columns.size());
+	for(std::size_t j=0;j<channel.columns.size();j++)
+	  writeLogString(os,channel.columns[j]);
+	writeLogValue(os,channel.offset);
+	writeLogValue(os,channel.stride);
+      }
+  }
+
+  /// Size in bytes of the header.
+  inline uint64_t logHeaderSize(const LogHeader &header)
+  {
+    uint64_t size = sizeof(LOG_MAGIC) + 2*sizeof(uint32_t) + 2*sizeof(uint64_t);
+    for(std::size_t i=0;i<header.channels.size();i++)
+      {
+	const LogChannelHeader &channel = header.channels[i];
+	size += 4 + channel.name.size() + 4 + channel.unit.size() + 2*4;
+	for(std::size_t j=0;j<channel.columns.size();j++)
+	  size += 4 + channel.columns[j].size();
+	size += 2*8;
+      }
+    return size;
+  }
+
+  /// Returns true if the stream starts with the magic of the container.
+  inline bool isLogContainer(std::istream &is)
+  {
+    char magic[sizeof(LOG_MAGIC)];
+    is.read(magic, sizeof(magic));
+    bool ok = is.good() && memcmp(magic, LOG_MAGIC, sizeof(LOG_MAGIC))==0;
+    is.clear();
+    is.seekg(0);
+    return ok;
+  }
+
+  /// Read the header. Returns false if the stream is not a container.
+  inline bool readLogHeader(std::istream &is, LogHeader &header)
+  {
+    char magic[sizeof(LOG_MAGIC)];
+    is.read(magic, sizeof(magic));
+    if (!is.good() || memcmp(magic, LOG_MAGIC, sizeof(LOG_MAGIC))!=0)
+      return false;
+
+    uint32_t version, nbChannels;
+    if (!readLogValue(is,version) || version<1 || version>LOG_VERSION ||
+	!readLogValue(is,nbChannels) ||
+	!readLogValue(is,header.nbSamples))
+      return false;
+    header.nbDropped = 0;
+    if (version>=2 && !readLogValue(is,header.nbDropped))
+      return false;
+
+    header.channels.resize(nbChannels);
+    for(uint32_t i=0;i<nbChannels;i++)
+      {
+	LogChannelHeader &channel = header.channels[i];
+	uint32_t nbColumns;
+	if (!readLogString(is,channel.name) ||
+	    !readLogString(is,channel.unit) ||
+	    !readLogValue(is,channel.type) ||
+	    !readLogValue(is,nbColumns))
+	  return false;
+	channel.columns.resize(nbColumns);
+	for(uint32_t j=0;j<nbColumns;j++)
+	  if (!readLogString(is,channel.columns[j]))
+	    return false;
+	if (!readLogValue(is,channel.offset) ||
+	    !readLogValue(is,channel.stride))
+	  return false;
+      }
+    return true;
+  }
+}
+
+#endif /* _RC_SOT_SYSTEM_LOG_FORMAT_H_ */
@@ -0,0 +1,45 @@
+/*
+   Text of the doubles written by roscontrol-sot-parse-log.
+
+   Each value is written with the fewest digits that read back as the
+   same double, by std::to_chars (C++17, GCC 11 or later). Without it,
+   the value is written with %.17g, which always reads back as the same
+   double but is longer.
+*/
+
+#ifndef _RC_SOT_SYSTEM_LOG_TEXT_H_
+#define _RC_SOT_SYSTEM_LOG_TEXT_H_
+
+#include <cstddef>
+#include <cstdio>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+# if __has_include(<charconv>)
+#  include <charconv>
+# endif
+#endif
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+# define RC_SOT_LOG_TEXT_SHORTEST 1
+#endif
+
+namespace rc_sot_system {
+
+// Longest text of a double: "-1.2345678901234567e-308".
+static const std::size_t MAX_DOUBLE_TEXT = 32;
+
+// Write v so that it reads back as v, with '.' as separator (the tool
+// keeps the C locale). Returns the number of characters, out has room
+// for MAX_DOUBLE_TEXT.
+inline int formatDouble (double v, char* out)
+{
+#ifdef RC_SOT_LOG_TEXT_SHORTEST
+  return (int)(std::to_chars (out, out + MAX_DOUBLE_TEXT, v).ptr - out);
+#else
+  return snprintf (out, MAX_DOUBLE_TEXT, "%.17g", v);
+#endif
+}
+
+}
+
+#endif /* _RC_SOT_SYSTEM_LOG_TEXT_H_ */
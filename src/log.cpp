@@ -4,11 +4,22 @@
    Object to log the low-level informations of a robot.
 */
 #include "log.hh"
-#include <sys/time.h>
+#include "log-format.hh"
+#include "log-codec.hh"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <sstream>
 #include <fstream>
 #include <iomanip>
 
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
 #include<ros/console.h>
 
 using namespace std;
@@ -31,7 +42,9 @@ void DataToLog::init(unsigned int nbDofs,long int length)
   force_sensors.resize(4*6*length);
   temperatures.resize(nbDofs*length);
   timestamp.resize(length);
+  ros_time.resize(length);
   duration.resize(length);
+  phases.resize(NB_PHASES*length);
 
   for(unsigned int i=0;i<nbDofs*length;i++)
     { motor_angle[i] = joint_angle[i] = 
@@ -42,21 +55,56 @@ void DataToLog::init(unsigned int nbDofs,long int length)
 
 Log::Log():  
   lref_(0),
-  lrefts_(0)
+  lrefts_(0),
+  wrapped_(false),
+  recorded_(0),
+  snapshot_first_(0),
+  snapshot_size_(0),
+  timeorigin_(0),
+  time_start_it_(0),
+  time_stop_it_(0),
+  save_status_(SAVE_IDLE),
+  format_(LOG_FORMAT_CHANNELS),
+  compression_(false),
+  save_threads_(1),
+  pipelined_(false),
+  mapped_fd_(-1),
+  mapped_data_(NULL),
+  mapped_size_(0),
+  mapped_timestamp_(NULL),
+  mapped_stride_(0),
+  mapped_dropped_(0),
+  streaming_(false),
+  stream_running_(false),
+  stream_flush_(false),
+  stream_recorded_(0),
+  stream_dropped_(0),
+  stream_last_timestamp_(0)
+{
+  std::fill(time_phases_,time_phases_+NB_PHASES,0);
+}
+
+Log::~Log()
 {
+  waitSave();
+  stream_running_.store(false,boost::memory_order_release);
+  if (stream_thread_.joinable())
+    stream_thread_.join();
+  unmap();
 }
 
 void Log::init(unsigned int nbDofs, unsigned int length)
 {
+  waitSave();
+  unmap();
   lref_ =0;
   lrefts_=0;
+  wrapped_=false;
   nbDofs_=nbDofs;
   length_=length;
   StoredData_.init(nbDofs,length);
-  struct timeval current;
-  gettimeofday(&current,0);
-
-  timeorigin_ = (double)current.tv_sec + 0.000001 * ((double)current.tv_usec);
+  recorded_.store(0);
+  timeorigin_ = monotonicNs();
 
 }
 
@@ -66,6 +114,25 @@ void Log::record(DataToLog &aDataToLog)
        (aDataToLog.velocities.size()!=nbDofs_))
     return;
 
+  // The streaming thread keeps writing while the file is synced.
+  if (streaming_)
+    {
+      recordStream(aDataToLog,monotonicNs()-timeorigin_);
+      return;
+    }
+
+  if (mapped_data_!=NULL)
+    {
+      // The container is being reordered and written on disk.
+      if (save_status_.load(boost::memory_order_acquire)==SAVE_RUNNING)
+	{
+	  mapped_dropped_.fetch_add(1,boost::memory_order_relaxed);
+	  return;
+	}
+      recordMapped(aDataToLog,monotonicNs()-timeorigin_);
+      return;
+    }
+
   for(unsigned int JointID=0;JointID<nbDofs_;JointID++)
     {
       if (aDataToLog.motor_angle.size()>JointID)
@@ -94,13 +161,13 @@ void Log::record(DataToLog &aDataToLog)
 	    aDataToLog.force_sensors[fsID*6+axis];
 	}
     }
-  struct timeval current;
-  gettimeofday(&current,0);
-
-  StoredData_.timestamp[lrefts_] = 
-    ((double)current.tv_sec + 0.000001 * (double)current.tv_usec) - timeorigin_;
+  StoredData_.timestamp[lrefts_] = monotonicNs() - timeorigin_;
+  StoredData_.ros_time[lrefts_] =
+    aDataToLog.ros_time.empty() ? 0.0 : aDataToLog.ros_time[0];
 
-  StoredData_.duration[lrefts_] = time_stop_it_ - time_start_it_;
+  StoredData_.duration[lrefts_] = 1e-9*(double)(time_stop_it_ - time_start_it_);
+  for(unsigned int phase=0;phase<NB_PHASES;phase++)
+    StoredData_.phases[lrefts_*NB_PHASES+phase] = phaseDuration(phase);
     
   lref_ += nbDofs_;
   lrefts_ ++;
@@ -108,56 +175,726 @@ void Log::record(DataToLog &aDataToLog)
     {
       lref_=0;
       lrefts_=0;
+      wrapped_=true;
     }
+  // Publish the sample to the writer thread.
+  recorded_.fetch_add(1,boost::memory_order_release);
 }
 
-void Log::start_it()
+void Log::takeSnapshot()
 {
-  struct timeval current;
-  gettimeofday(&current,0);
+  if (!snapshot_)
+    snapshot_.reset(new DataToLog);
+  uint64_t before = recorded_.load(boost::memory_order_acquire);
+  *snapshot_ = StoredData_;
+  boost::atomic_thread_fence(boost::memory_order_acquire);
+  uint64_t after = recorded_.load(boost::memory_order_relaxed);
+
+  // Recording the sample m overwrites the sample m-length_. The samples
+  // up to after were recorded during the copy, the sample after+1 may
+  // have been started: their positions are not kept.
+  uint64_t first = before>length_ ? before-length_ : 0;
+  if (after+2>length_ && after+2-length_>first)
+    first = after+2-length_;
+  snapshot_size_ = before>first ? (unsigned long)(before-first) : 0;
+  snapshot_first_ = length_>0 ? (unsigned long)(first%length_) : 0;
+}
 
-  time_start_it_ = 
-    ((double)current.tv_sec + 0.000001 * (double)current.tv_usec) - timeorigin_;
-  
+unsigned long Log::nbSamples() const
+{
+  return wrapped_ ? length_ : lrefts_;
+}
+
+// Read and write back one value per page.
+static std::size_t prefaultPages(volatile char *data, std::size_t size)
+{
+  const std::size_t page = (std::size_t)sysconf(_SC_PAGESIZE);
+  for(std::size_t i=0;i<size;i+=page)
+    data[i] = data[i];
+  return size;
+}
+
+template<typename T>
+static std::size_t prefaultVector(std::vector<T> &data)
+{
+  if (data.empty())
+    return 0;
+  return prefaultPages((volatile char*)&data[0],data.size()*sizeof(T));
+}
+
+std::size_t Log::prefault()
+{
+  if (mapped_data_!=NULL)
+    return prefaultPages(mapped_data_,mapped_size_);
+
+  std::size_t size = 0;
+  size += prefaultVector(StoredData_.motor_angle);
+  size += prefaultVector(StoredData_.joint_angle);
+  size += prefaultVector(StoredData_.velocities);
+  size += prefaultVector(StoredData_.torques);
+  size += prefaultVector(StoredData_.orientation);
+  size += prefaultVector(StoredData_.accelerometer);
+  size += prefaultVector(StoredData_.gyrometer);
+  size += prefaultVector(StoredData_.force_sensors);
+  size += prefaultVector(StoredData_.motor_currents);
+  size += prefaultVector(StoredData_.temperatures);
+  size += prefaultVector(StoredData_.timestamp);
+  size += prefaultVector(StoredData_.duration);
+  size += prefaultVector(StoredData_.phases);
+  size += prefaultVector(StoredData_.ros_time);
+  size += prefaultVector(stream_sample_);
+  return size;
+}
+
+void Log::start_it()
+{
+  time_start_it_ = monotonicNs();
 }
 
 void Log::stop_it()
 {
-  struct timeval current;
-  gettimeofday(&current,0);
+  time_stop_it_ = monotonicNs();
+}
+
+double Log::phaseDuration(unsigned int phase) const
+{
+  int64_t start = phase==0 ? time_start_it_ : time_phases_[phase-1];
+  return 1e-9*(double)(time_phases_[phase] - start);
+}
+
+bool Log::save(std::string &fileName)
+{
+  if (streaming_)
+    {
+      if (saveAsync(fileName))
+	waitSave();
+      return saveStatus()==SAVE_DONE;
+    }
+
+  if (mapped_data_!=NULL)
+    {
+      if (fileName!=mapped_filename_)
+	ROS_WARN_STREAM("The log is mapped to " << mapped_filename_
+			<< ", " << fileName << " is not written.");
+      return saveMapped();
+    }
+
+  // The copy of the buffer is released once written.
+  takeSnapshot();
+  if (format_==LOG_FORMAT_CONTAINER)
+    {
+      bool ok = saveContainer(fileName);
+      snapshot_.reset();
+      return ok;
+    }
+
+  std::vector<LogChannel> channels;
+  buildChannels(*snapshot_,channels);
+
+  // The channels are shared between the calling thread and
+  // save_threads_-1 helpers.
+  boost::atomic<std::size_t> next(0);
+  boost::atomic<bool> ok(true);
+  boost::thread_group pool;
+  const std::size_t nbThreads = std::min<std::size_t>(save_threads_,
+						      channels.size());
+  for(std::size_t i=1;i<nbThreads;i++)
+    pool.create_thread(boost::bind(&Log::saveChannels,this,
+				   boost::ref(fileName),boost::ref(channels),
+				   boost::ref(next),boost::ref(ok)));
+  saveChannels(fileName,channels,next,ok);
+  pool.join_all();
+  snapshot_.reset();
+  return ok.load();
+}
+
+void Log::setSaveThreads(unsigned int nbThreads)
+{
+  save_threads_ = std::max(1u,nbThreads);
+}
+
+void Log::setJointNames(const std::vector<std::string> &names)
+{
+  joint_names_ = names;
+}
+
+void Log::setImuName(const std::string &name)
+{
+  imu_name_ = name;
+}
+
+void Log::setForceSensorNames(const std::vector<std::string> &names)
+{
+  force_sensor_names_ = names;
+}
+
+static void addChannel(std::vector<LogChannel> &channels,
+		       const char *name, const char *suffix, const char *unit,
+		       const DataToLog &stored,
+		       std::vector<double> DataToLog::* member,
+		       unsigned int size)
+{
+  channels.push_back(LogChannel());
+  LogChannel &channel = channels.back();
+  channel.name = name;
+  channel.suffix = suffix;
+  channel.unit = unit;
+  channel.member = member;
+  channel.data = &(stored.*member);
+  channel.size = size;
+}
+
+void Log::buildChannels(const DataToLog &stored,
+			std::vector<LogChannel> &channels) const
+{
+  channels.clear();
+  addChannel(channels,"motor_angle","-mastate.log","rad",
+	     stored,&DataToLog::motor_angle,nbDofs_);
+  addChannel(channels,"joint_angle","-jastate.log","rad",
+	     stored,&DataToLog::joint_angle,nbDofs_);
+  addChannel(channels,"velocities","-vstate.log","rad/s",
+	     stored,&DataToLog::velocities,nbDofs_);
+  addChannel(channels,"torques","-torques.log","N.m",
+	     stored,&DataToLog::torques,nbDofs_);
+  addChannel(channels,"motor_currents","-motor-currents.log","A",
+	     stored,&DataToLog::motor_currents,nbDofs_);
+  addChannel(channels,"accelerometer","-accelero.log","m/s^2",
+	     stored,&DataToLog::accelerometer,3);
+  addChannel(channels,"gyrometer","-gyro.log","rad/s",
+	     stored,&DataToLog::gyrometer,3);
+  addChannel(channels,"force_sensors","-forceSensors.log","N|N.m",
+	     stored,&DataToLog::force_sensors,24);
+  addChannel(channels,"temperatures","-temperatures.log","degC",
+	     stored,&DataToLog::temperatures,nbDofs_);
+  addChannel(channels,"duration","-duration.log","s",
+	     stored,&DataToLog::duration,1);
+  addChannel(channels,"ros_time","-rostime.log","s",
+	     stored,&DataToLog::ros_time,1);
+  addChannel(channels,"phases","-phases.log","s",
+	     stored,&DataToLog::phases,NB_PHASES);
+
+  // Name of the columns.
+  const char * axes[3] = { "x", "y", "z" };
+  const char * wrench[6] = { "fx", "fy", "fz", "tx", "ty", "tz" };
+  const char * phases[NB_PHASES] =
+    { "fill_sensors", "set_sensors", "get_control", "read_control" };
+  const char * pipelinedPhases[NB_PHASES] =
+    { "fill_sensors", "wait_worker", "snapshot", "read_control" };
+  std::string imu = imu_name_.empty() ? std::string("imu") : imu_name_;
+  for(std::size_t i=0;i<channels.size();i++)
+    {
+      LogChannel &channel = channels[i];
+      for(unsigned int j=0;j<channel.size;j++)
+	{
+	  ostringstream oss;
+	  if (channel.member==&DataToLog::accelerometer ||
+	      channel.member==&DataToLog::gyrometer)
+	    oss << imu << '/' << axes[j];
+	  else if (channel.member==&DataToLog::force_sensors)
+	    {
+	      if (j/6<force_sensor_names_.size())
+		oss << force_sensor_names_[j/6];
+	      else
+		oss << "force_sensor_" << j/6;
+	      oss << '/' << wrench[j%6];
+	    }
+	  else if (channel.member==&DataToLog::duration)
+	    oss << "duration";
+	  else if (channel.member==&DataToLog::ros_time)
+	    oss << "ros_time";
+	  else if (channel.member==&DataToLog::phases)
+	    oss << (pipelined_ ? pipelinedPhases[j] : phases[j]);
+	  else if (j<joint_names_.size())
+	    oss << joint_names_[j];
+	  else
+	    oss << "joint_" << j;
+	  channel.columns.push_back(oss.str());
+	}
+    }
+}
+
+unsigned long Log::sampleIndex(unsigned long k) const
+{
+  unsigned long i = snapshot_first_+k;
+  if (i>=length_)
+    i -= length_;
+  return i;
+}
+
+void Log::buildContainerHeader(const std::vector<LogChannel> &channels,
+			       unsigned long capacity,
+			       LogHeader &header) const
+{
+  // The time base is stored once as the first channel.
+  header.nbSamples = capacity;
+  header.channels.clear();
+  header.channels.resize(channels.size()+1);
+  header.channels[0].name = "time";
+  header.channels[0].unit = "s";
+  header.channels[0].columns.push_back("t");
+  for(std::size_t i=0;i<channels.size();i++)
+    {
+      header.channels[i+1].name = channels[i].name;
+      header.channels[i+1].unit = channels[i].unit;
+      header.channels[i+1].columns = channels[i].columns;
+    }
+
+  // Place the columns after the header.
+  uint64_t offset = alignLogOffset(logHeaderSize(header));
+  const uint64_t stride = alignLogOffset(capacity*sizeof(double));
+  for(std::size_t i=0;i<header.channels.size();i++)
+    {
+      header.channels[i].offset = offset;
+      header.channels[i].stride = stride;
+      offset += stride*header.channels[i].columns.size();
+    }
+}
+
+bool Log::saveContainer(std::string &fileName)
+{
+  std::vector<LogChannel> channels;
+  buildChannels(*snapshot_,channels);
+
+  LogHeader header;
+  buildContainerHeader(channels,snapshot_size_,header);
+  const uint64_t stride = header.channels[0].stride;
+
+  // Compressed columns have a variable size: each channel points to a
+  // table giving the position and the size of its columns.
+  uint64_t dataOffset = 0;
+  if (compression_)
+    {
+      uint64_t offset = alignLogOffset(logHeaderSize(header));
+      for(std::size_t i=0;i<header.channels.size();i++)
+	{
+	  header.channels[i].type = LOG_TYPE_DOUBLE_XOR;
+	  header.channels[i].offset = offset;
+	  header.channels[i].stride = 0;
+	  offset += 2*sizeof(uint64_t)*header.channels[i].columns.size();
+	}
+      dataOffset = alignLogOffset(offset);
+    }
+
+  ofstream aof(fileName.c_str(), std::ios::binary | std::ios::trunc);
+  if (!aof.is_open())
+    {
+      ROS_ERROR_STREAM("Could not write log file " << fileName);
+      return false;
+    }
+  writeLogHeader(aof,header);
+  const char padding[LOG_ALIGNMENT] = { 0 };
+  aof.write(padding,header.channels[0].offset-logHeaderSize(header));
+
+  // Gather each column in chronological order.
+  std::vector<double> column(stride/sizeof(double)+1,0.0);
+  std::vector<uint64_t> table;
+  std::vector<unsigned char> encoded;
+  if (compression_)
+    {
+      std::size_t nbColumns = 0;
+      for(std::size_t i=0;i<header.channels.size();i++)
+	nbColumns += header.channels[i].columns.size();
+      table.resize(2*nbColumns,0);
+      aof.write((char*)&table[0],table.size()*sizeof(uint64_t));
+      aof.write(padding,dataOffset-header.channels[0].offset
+		-table.size()*sizeof(uint64_t));
+      table.clear();
+    }
+
+  uint64_t position = dataOffset;
+  for(std::size_t i=0;i<=channels.size();i++)
+    {
+      // The first channel of the container is the time base.
+      const LogChannel * channel = i==0 ? NULL : &channels[i-1];
+      const unsigned int size = channel==NULL ? 1 : channel->size;
+      for(unsigned int j=0;j<size;j++)
+	{
+	  if (channel==NULL)
+	    for(unsigned long k=0;k<header.nbSamples;k++)
+	      column[k] = 1e-9*(double)snapshot_->timestamp[sampleIndex(k)];
+	  else
+	    for(unsigned long k=0;k<header.nbSamples;k++)
+	      column[k] = (*channel->data)[sampleIndex(k)*size+j];
+
+	  if (!compression_)
+	    {
+	      aof.write((char*)&column[0],stride);
+	      continue;
+	    }
+	  encoded.clear();
+	  encodeLogColumn(&column[0],header.nbSamples,encoded);
+	  if (!encoded.empty())
+	    aof.write((char*)&encoded[0],encoded.size());
+	  table.push_back(position);
+	  table.push_back(encoded.size());
+	  position += encoded.size();
+	}
+    }
+
+  // Fill the tables of the compressed columns.
+  if (compression_)
+    {
+      aof.seekp(header.channels[0].offset);
+      aof.write((char*)&table[0],table.size()*sizeof(uint64_t));
+      ROS_INFO_STREAM("Compressed log: " << position-dataOffset
+		      << " bytes instead of "
+		      << (table.size()/2)*header.nbSamples*sizeof(double));
+    }
+  aof.close();
+  if (aof.fail())
+    {
+      ROS_ERROR_STREAM("Could not write log file " << fileName);
+      return false;
+    }
+  ROS_INFO_STREAM("Wrote log file " << fileName);
+  return true;
+}
+
+bool Log::saveAsync(std::string &fileName)
+{
+  if (save_status_.load(boost::memory_order_acquire)==SAVE_RUNNING)
+    return false;
+
+  // In streaming mode the samples are already on disk: the streaming
+  // thread drains the queue and syncs the file, and keeps running for
+  // the next start of the controller.
+  if (streaming_)
+    {
+      if (!stream_running_.load(boost::memory_order_acquire))
+	return false;
+      save_status_.store(SAVE_RUNNING,boost::memory_order_release);
+      stream_flush_.store(true,boost::memory_order_release);
+      return true;
+    }
 
-  time_stop_it_ = 
-    ((double)current.tv_sec + 0.000001 * (double)current.tv_usec) - timeorigin_;
+  // Release the thread of the previous save.
+  if (save_thread_.joinable())
+    save_thread_.join();
+
+  save_filename_ = fileName;
+  save_status_.store(SAVE_RUNNING,boost::memory_order_release);
+  save_thread_ = boost::thread(&Log::saveThread,this);
+  return true;
 }
 
-void Log::save(std::string &fileName)
+void Log::saveThread()
 {
-  std::string suffix("-mastate.log");
-  saveVector(fileName,suffix,StoredData_.motor_angle, nbDofs_);
-  suffix="-jastate.log";
-  saveVector(fileName,suffix,StoredData_.joint_angle, nbDofs_);
-  suffix = "-vstate.log";
-  saveVector(fileName,suffix,StoredData_.velocities, nbDofs_);
-  suffix = "-torques.log";
-  saveVector(fileName,suffix,StoredData_.torques, nbDofs_);
-  suffix = "-motor-currents.log";
-  saveVector(fileName,suffix,StoredData_.motor_currents, nbDofs_);
-  suffix = "-accelero.log";
-  saveVector(fileName,suffix,StoredData_.accelerometer, 3);
-  suffix = "-gyro.log";
-  saveVector(fileName,suffix,StoredData_.gyrometer, 3);
+  bool ok = save(save_filename_);
+  save_status_.store(ok ? SAVE_DONE : SAVE_FAILED,
+		     boost::memory_order_release);
+}
 
+SaveStatus Log::saveStatus() const
+{
+  return (SaveStatus)save_status_.load(boost::memory_order_acquire);
+}
+
+bool Log::initMapped(unsigned int nbDofs, unsigned int length,
+		     std::string &fileName)
+{
+  waitSave();
+  unmap();
+
+  lref_ = 0;
+  lrefts_ = 0;
+  wrapped_ = false;
+  nbDofs_ = nbDofs;
+  length_ = length;
+  mapped_dropped_.store(0);
+
+  buildChannels(StoredData_,mapped_channels_);
+  LogHeader header;
+  buildContainerHeader(mapped_channels_,length_,header);
+  const LogChannelHeader &last = header.channels.back();
+  mapped_size_ = last.offset + last.stride*last.columns.size();
+  mapped_stride_ = header.channels[0].stride/sizeof(double);
+
+  mapped_fd_ = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (mapped_fd_<0 || ftruncate(mapped_fd_,mapped_size_)!=0)
+    {
+      ROS_ERROR_STREAM("Could not create mapped log file " << fileName
+		       << ": " << strerror(errno));
+      unmap();
+      return false;
+    }
+  void * data = mmap(NULL,mapped_size_,PROT_READ | PROT_WRITE,
+		     MAP_SHARED,mapped_fd_,0);
+  if (data==MAP_FAILED)
+    {
+      ROS_ERROR_STREAM("Could not map log file " << fileName
+		       << ": " << strerror(errno));
+      unmap();
+      return false;
+    }
+  mapped_data_ = (char*)data;
+  mapped_filename_ = fileName;
+
+  // The numbers of samples in the header are updated when saving.
+  header.nbSamples = 0;
   ostringstream oss;
-  oss << "-forceSensors.log";
-  suffix = oss.str();
-  saveVector(fileName,suffix,StoredData_.force_sensors, 6);
+  writeLogHeader(oss,header);
+  std::string sheader = oss.str();
+  memcpy(mapped_data_,sheader.data(),sheader.size());
 
-  suffix = "-temperatures.log";
-  saveVector(fileName,suffix,StoredData_.temperatures, nbDofs_);
+  mapped_timestamp_ = (double*)(mapped_data_+header.channels[0].offset);
+  mapped_columns_.resize(mapped_channels_.size());
+  for(std::size_t i=0;i<mapped_channels_.size();i++)
+    mapped_columns_[i] = (double*)(mapped_data_+header.channels[i+1].offset);
 
-  suffix = "-duration.log";
-  saveVector(fileName,suffix,StoredData_.duration, 1);
+  timeorigin_ = monotonicNs();
+  return true;
+}
 
+void Log::unmap()
+{
+  if (mapped_data_!=NULL)
+    munmap(mapped_data_,mapped_size_);
+  if (mapped_fd_>=0)
+    close(mapped_fd_);
+  mapped_data_ = NULL;
+  mapped_fd_ = -1;
+  mapped_size_ = 0;
+  mapped_timestamp_ = NULL;
+  mapped_columns_.clear();
+  mapped_channels_.clear();
+}
+
+void Log::recordMapped(DataToLog &aDataToLog, int64_t timestamp)
+{
+  mapped_timestamp_[lrefts_] = 1e-9*(double)timestamp;
+  for(std::size_t i=0;i<mapped_channels_.size();i++)
+    {
+      const LogChannel &channel = mapped_channels_[i];
+      double * column = mapped_columns_[i] + lrefts_;
+      if (channel.member==&DataToLog::duration)
+	{
+	  *column = 1e-9*(double)(time_stop_it_ - time_start_it_);
+	  continue;
+	}
+      if (channel.member==&DataToLog::phases)
+	{
+	  for(unsigned int j=0;j<channel.size;j++)
+	    column[j*mapped_stride_] = phaseDuration(j);
+	  continue;
+	}
+      const std::vector<double> &data = aDataToLog.*(channel.member);
+      for(unsigned int j=0;j<channel.size;j++)
+	column[j*mapped_stride_] = j<data.size() ? data[j] : 0.0;
+    }
+
+  lref_ += nbDofs_;
+  lrefts_ ++;
+  if (lrefts_>=length_)
+    {
+      lref_=0;
+      lrefts_=0;
+      wrapped_=true;
+    }
+}
+
+bool Log::saveMapped()
+{
+  // Put the oldest sample first in each column.
+  if (wrapped_ && lrefts_>0)
+    {
+      std::rotate(mapped_timestamp_,mapped_timestamp_+lrefts_,
+		  mapped_timestamp_+length_);
+      for(std::size_t i=0;i<mapped_channels_.size();i++)
+	for(unsigned int j=0;j<mapped_channels_[i].size;j++)
+	  {
+	    double * column = mapped_columns_[i] + j*mapped_stride_;
+	    std::rotate(column,column+lrefts_,column+length_);
+	  }
+      // Recording goes on after the newest sample.
+      lref_ = 0;
+      lrefts_ = 0;
+    }
+
+  // Update the numbers of samples in the header.
+  uint64_t nbValid = nbSamples();
+  uint64_t nbDropped = mapped_dropped_.load(boost::memory_order_relaxed);
+  char * counts = mapped_data_+sizeof(LOG_MAGIC)+2*sizeof(uint32_t);
+  memcpy(counts,&nbValid,sizeof(nbValid));
+  memcpy(counts+sizeof(nbValid),&nbDropped,sizeof(nbDropped));
+
+  if (msync(mapped_data_,mapped_size_,MS_SYNC)!=0)
+    {
+      ROS_ERROR_STREAM("Could not write log file " << mapped_filename_
+		       << ": " << strerror(errno));
+      return false;
+    }
+  ROS_INFO_STREAM("Wrote log file " << mapped_filename_ << ": "
+		  << nbValid << " samples, " << nbDropped
+		  << " dropped while saving");
+  return true;
+}
+
+void Log::waitSave()
+{
+  if (save_thread_.joinable())
+    save_thread_.join();
+  // The streaming thread clears the flag once the file is synced,
+  // or when it stops on an error.
+  while (streaming_ && stream_flush_.load(boost::memory_order_acquire)
+	 && stream_thread_.joinable()
+	 && stream_running_.load(boost::memory_order_acquire))
+    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+}
+
+bool Log::initStreaming(unsigned int nbDofs, std::string &fileName,
+			unsigned int capacity)
+{
+  waitSave();
+  if (stream_thread_.joinable())
+    {
+      stream_running_.store(false,boost::memory_order_release);
+      stream_thread_.join();
+    }
+
+  nbDofs_ = nbDofs;
+  length_ = 0;
+  lref_ = 0;
+  lrefts_ = 0;
+  wrapped_ = false;
+
+  stream_sample_.resize(2+6*nbDofs_+3+3+24+2+NB_PHASES);
+  stream_queue_.reset(new boost::lockfree::spsc_queue<double>
+		      (capacity*stream_sample_.size()));
+  stream_recorded_.store(0);
+  stream_dropped_.store(0);
+  stream_flush_.store(false);
+  stream_last_timestamp_ = 0;
+  stream_filename_ = fileName + "-stream.log";
+
+  timeorigin_ = monotonicNs();
+
+  streaming_ = true;
+  save_status_.store(SAVE_IDLE,boost::memory_order_release);
+  stream_running_.store(true,boost::memory_order_release);
+  stream_thread_ = boost::thread(&Log::streamThread,this);
+  return true;
+}
+
+unsigned long Log::streamedSamples() const
+{
+  return stream_recorded_.load(boost::memory_order_relaxed);
+}
+
+unsigned long Log::droppedSamples() const
+{
+  return stream_dropped_.load(boost::memory_order_relaxed);
+}
+
+static inline double * copyToSample(double *sample,
+				    const std::vector<double> &data,
+				    std::size_t size)
+{
+  for(std::size_t i=0;i<size;i++)
+    sample[i] = i<data.size() ? data[i] : 0.0;
+  return sample+size;
+}
+
+void Log::recordStream(DataToLog &aDataToLog, int64_t timestamp)
+{
+  double *sample = &stream_sample_[0];
+  *sample++ = 1e-9*(double)timestamp;
+  *sample++ = 1e-9*(double)(timestamp - stream_last_timestamp_);
+  stream_last_timestamp_ = timestamp;
+
+  sample = copyToSample(sample,aDataToLog.motor_angle,nbDofs_);
+  sample = copyToSample(sample,aDataToLog.joint_angle,nbDofs_);
+  sample = copyToSample(sample,aDataToLog.velocities,nbDofs_);
+  sample = copyToSample(sample,aDataToLog.torques,nbDofs_);
+  sample = copyToSample(sample,aDataToLog.motor_currents,nbDofs_);
+  sample = copyToSample(sample,aDataToLog.accelerometer,3);
+  sample = copyToSample(sample,aDataToLog.gyrometer,3);
+  sample = copyToSample(sample,aDataToLog.force_sensors,24);
+  sample = copyToSample(sample,aDataToLog.temperatures,nbDofs_);
+  *sample++ = 1e-9*(double)(time_stop_it_ - time_start_it_);
+  *sample++ = aDataToLog.ros_time.empty() ? 0.0 : aDataToLog.ros_time[0];
+  for(unsigned int phase=0;phase<NB_PHASES;phase++)
+    *sample++ = phaseDuration(phase);
+
+  // Push the whole sample or nothing: the writer thread only sees
+  // complete rows.
+  if (stream_queue_->write_available()<stream_sample_.size())
+    {
+      stream_dropped_.fetch_add(1,boost::memory_order_relaxed);
+      return;
+    }
+  stream_queue_->push(&stream_sample_[0],stream_sample_.size());
+  stream_recorded_.fetch_add(1,boost::memory_order_relaxed);
+}
+
+// Write size bytes, returns false on error.
+static bool writeAll(int fd, const char *data, std::size_t size)
+{
+  while (size>0)
+    {
+      ssize_t n = write(fd,data,size);
+      if (n<0 && errno==EINTR)
+	continue;
+      if (n<=0)
+	return false;
+      data += n;
+      size -= n;
+    }
+  return true;
+}
+
+void Log::streamThread()
+{
+  const std::size_t sampleSize = stream_sample_.size();
+  // Write by chunks of 256 samples.
+  std::vector<double> buffer(256*sampleSize);
+
+  int fd = open(stream_filename_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd<0)
+    {
+      ROS_ERROR_STREAM("Could not write log file " << stream_filename_
+		       << ": " << strerror(errno));
+      stream_running_.store(false,boost::memory_order_release);
+      save_status_.store(SAVE_FAILED,boost::memory_order_release);
+      return;
+    }
+
+  // The number of samples is rewritten after each chunk, so that the
+  // file can be read if the process dies, and synced on each flush.
+  unsigned int nVector = 0, vectorSize = (unsigned int)sampleSize;
+  bool ok = writeAll(fd,(char*)&nVector,sizeof(unsigned int))
+    && writeAll(fd,(char*)&vectorSize,sizeof(unsigned int));
+
+  bool running = true;
+  while (running)
+    {
+      // Read the flags before draining so that the last samples are
+      // written before the file is synced.
+      running = stream_running_.load(boost::memory_order_acquire);
+      bool flush = stream_flush_.load(boost::memory_order_acquire);
+      std::size_t nbPopped;
+      while ((nbPopped = stream_queue_->pop(&buffer[0],buffer.size()))>0)
+	{
+	  ok = writeAll(fd,(char*)&buffer[0],nbPopped*sizeof(double)) && ok;
+	  nVector += (unsigned int)(nbPopped/sampleSize);
+	  ok = pwrite(fd,&nVector,sizeof(unsigned int),0)
+	    ==(ssize_t)sizeof(unsigned int) && ok;
+	}
+      if (flush || !running)
+	{
+	  ok = fsync(fd)==0 && ok;
+	  ROS_INFO_STREAM("Wrote log file " << stream_filename_ << ": "
+			  << nVector << " samples, "
+			  << droppedSamples() << " dropped");
+	  save_status_.store(ok ? SAVE_DONE : SAVE_FAILED,
+			     boost::memory_order_release);
+	  stream_flush_.store(false,boost::memory_order_release);
+	}
+      if (running)
+	boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+  ok = close(fd)==0 && ok;
+  if (!ok)
+    save_status_.store(SAVE_FAILED,boost::memory_order_release);
 }
 
 inline void writeHeaderToBinaryBuffer (ofstream& of,
@@ -168,16 +905,20 @@ inline void writeHeaderToBinaryBuffer (ofstream& of,
   of.write ((char*)&vectorSize, sizeof(unsigned int));
 }
 
-inline void writeToBinaryFile (ofstream& of,
+inline void writeToBinaryBuffer (double* row,
     const double& t, const double& dt,
     const std::vector<double>& data, const std::size_t& idx, const std::size_t& size)
 {
-  of.write ((char*)&t          ,       sizeof(double));
-  of.write ((char*)&dt         ,       sizeof(double));
-  of.write ((char*)(&data[idx]), size*(sizeof(double)));
+  row[0] = t;
+  row[1] = dt;
+  memcpy (row+2, &data[idx], size*sizeof(double));
 }
 
-void Log::saveVector(std::string &fileName,std::string &suffix,
+// The rows of a channel are formatted in a buffer of this size
+// which is written at once.
+static const std::size_t SAVE_BUFFER_SIZE = 1<<22;
+
+bool Log::saveVector(std::string &fileName,std::string &suffix,
 		     const std::vector<double> &avector,
 		     unsigned int size)
 {
@@ -188,22 +929,54 @@ void Log::saveVector(std::string &fileName,std::string &suffix,
 
   ofstream aof(actualFileName.c_str(), std::ios::binary | std::ios::trunc);
 
-  std::size_t idx = 0;
+  // Start from the oldest sample and only write the valid ones.
+  const unsigned long int nbValid = snapshot_size_;
+  const std::vector<int64_t> &timestamp = snapshot_->timestamp;
+  const std::size_t rowSize = size+2;
+  const unsigned long int blockRows =
+    std::max<std::size_t>(1,SAVE_BUFFER_SIZE/(rowSize*sizeof(double)));
   double dt;
   if (aof.is_open())
     {
-      writeHeaderToBinaryBuffer (aof, length_, size+2);
-      for(unsigned long int i=0;i<length_;i++)
+      writeHeaderToBinaryBuffer (aof, (unsigned int)nbValid, size+2);
+      std::vector<double> buffer(std::min(blockRows,nbValid)*rowSize+1);
+      unsigned long int prev = sampleIndex(0), nbRows = 0;
+      for(unsigned long int k=0;k<nbValid;k++)
 	{
+	  unsigned long int i = sampleIndex(k);
 	  // Compute and save dt
-	  if (i==0)
-            dt = StoredData_.timestamp[i] - StoredData_.timestamp[length_-1];
+	  if (k==0)
+	    dt = 0.0;
 	  else
-            dt = StoredData_.timestamp[i] - StoredData_.timestamp[i-1];
-          writeToBinaryFile (aof, StoredData_.timestamp[i], dt, avector, idx, size);
-          idx += size;
+	    dt = 1e-9*(double)(timestamp[i] - timestamp[prev]);
+	  writeToBinaryBuffer (&buffer[nbRows*rowSize],
+			       1e-9*(double)timestamp[i], dt, avector,
+			       i*size, size);
+	  prev = i;
+	  if (++nbRows==blockRows || k+1==nbValid)
+	    {
+	      aof.write ((char*)&buffer[0], nbRows*rowSize*sizeof(double));
+	      nbRows = 0;
+	    }
 	}
       aof.close();
-      ROS_INFO_STREAM("Wrote log file " << actualFileName);
+      if (!aof.fail())
+	{
+	  ROS_INFO_STREAM("Wrote log file " << actualFileName);
+	  return true;
+	}
     }
+  ROS_ERROR_STREAM("Could not write log file " << actualFileName);
+  return false;
+}
+
+void Log::saveChannels(std::string &fileName,
+		       std::vector<LogChannel> &channels,
+		       boost::atomic<std::size_t> &next,
+		       boost::atomic<bool> &ok)
+{
+  for(std::size_t i=next++;i<channels.size();i=next++)
+    if (!saveVector(fileName,channels[i].suffix,
+		    *channels[i].data,channels[i].size))
+      ok.store(false);
 }
@@ -7,11 +7,39 @@
 #ifndef _RC_SOT_SYSTEM_LOG_H_
 #define _RC_SOT_SYSTEM_LOG_H_
 
+#include <stdint.h>
+#include <time.h>
 #include <vector>
 #include <string>
 
+#include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+
 namespace rc_sot_system {
 
+  /// Monotonic time in ns, not affected by the steps of the system clock.
+  inline int64_t monotonicNs()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (int64_t)ts.tv_sec*1000000000LL + ts.tv_nsec;
+  }
+
+  /// Phases of one iteration of the controller, timed separately.
+  /// With the pipelined evaluation, the second phase is the wait for
+  /// the worker and the third one the copy of the snapshot: their
+  /// columns are named after them (see Log::setPipelined).
+  enum LogPhase
+  {
+    PHASE_FILL_SENSORS,
+    PHASE_SET_SENSORS,
+    PHASE_GET_CONTROL,
+    PHASE_READ_CONTROL,
+    NB_PHASES
+  };
+
   struct DataToLog
   {
     // Measured angle values at the motor side.
@@ -35,10 +63,14 @@ namespace rc_sot_system {
     // Measured temperatures
     std::vector<double> temperatures;
 
-    // Timestamp
-    std::vector<double> timestamp;
+    // Monotonic timestamp in ns since the initialization of the log.
+    std::vector<int64_t> timestamp;
     // Duration
     std::vector<double> duration;
+    // Duration of each phase of the iteration (see LogPhase).
+    std::vector<double> phases;
+    // Time given to the update of the controller, in s.
+    std::vector<double> ros_time;
 
     DataToLog();
     void init(unsigned int nbDofs, long int length);
@@ -46,6 +78,35 @@ namespace rc_sot_system {
 
   };
 
+  /// Status of the saving of the log.
+  enum SaveStatus { SAVE_IDLE, SAVE_RUNNING, SAVE_DONE, SAVE_FAILED };
+
+  /// Layout of the saved log:
+  /// LOG_FORMAT_CHANNELS writes one file per channel (fileName-*.log),
+  /// LOG_FORMAT_CONTAINER writes a single columnar file (fileName)
+  /// described in log-format.hh.
+  enum LogFormat { LOG_FORMAT_CHANNELS, LOG_FORMAT_CONTAINER };
+
+  /// Description of one logged quantity.
+  struct LogHeader;
+
+  struct LogChannel
+  {
+    // Name of the channel in the container.
+    std::string name;
+    // Suffix of the file of the channel.
+    std::string suffix;
+    std::string unit;
+    // Quantity of DataToLog recorded in the channel.
+    std::vector<double> DataToLog::* member;
+    // Circular buffer of the channel.
+    const std::vector<double> * data;
+    // Number of values per sample.
+    unsigned int size;
+    // Name of each value.
+    std::vector<std::string> columns;
+  };
+
   class Log
   {
   private:
@@ -59,30 +120,224 @@ namespace rc_sot_system {
     // Current position int the circular buffer for timestamp
     // lref_ = lrefts_ * nbDofs_
     long unsigned int lrefts_;
+    // True once the circular buffer has wrapped: the oldest sample
+    // is then at lrefts_.
+    bool wrapped_;
 
     // Circular buffer for all the data.
     DataToLog StoredData_;
+    // Number of samples recorded in the circular buffer since init:
+    // the sample n is at the position n%length_.
+    boost::atomic<uint64_t> recorded_;
+
+    // Copy of the circular buffer taken by the writer thread while
+    // record() goes on, released after the save.
+    boost::scoped_ptr<DataToLog> snapshot_;
+    // Position of the oldest sample in the snapshot and number of
+    // samples kept.
+    unsigned long snapshot_first_, snapshot_size_;
+    // Copy the circular buffer into snapshot_. The samples overwritten
+    // by record() during the copy are left out.
+    void takeSnapshot();
+
+    // Monotonic times in ns.
+    int64_t timeorigin_;
+    int64_t time_start_it_;
+    int64_t time_stop_it_;
+    // End of each phase of the iteration.
+    int64_t time_phases_[NB_PHASES];
+
+    // Duration in s of a phase of the last iteration.
+    double phaseDuration(unsigned int phase) const;
+
+    // Thread writing the log in background.
+    boost::thread save_thread_;
+    // Status of the last save, shared with the writer thread.
+    boost::atomic<int> save_status_;
+    // Prefix of the files written by the writer thread.
+    std::string save_filename_;
 
-    double timeorigin_;
-    double time_start_it_;
-    double time_stop_it_;
+    // Layout of the saved log.
+    LogFormat format_;
+    // Compress the columns of the container.
+    bool compression_;
+    // Number of threads writing the channels.
+    unsigned int save_threads_;
+    // Names used to describe the columns.
+    std::vector<std::string> joint_names_;
+    std::string imu_name_;
+    std::vector<std::string> force_sensor_names_;
+    // The phases are those of the pipelined evaluation.
+    bool pipelined_;
+
+    // Describe the channels stored in a copy of the circular buffer.
+    void buildChannels(const DataToLog &stored,
+		       std::vector<LogChannel> &channels) const;
+    // Position in the snapshot of the k-th oldest sample.
+    unsigned long sampleIndex(unsigned long k) const;
+    // Describe the container holding capacity samples per column.
+    void buildContainerHeader(const std::vector<LogChannel> &channels,
+			      unsigned long capacity,
+			      LogHeader &header) const;
+    // Save all the channels in a single columnar file.
+    bool saveContainer(std::string &fileName);
+
+    /// @{ \name Memory-mapped mode
+    // File descriptor of the mapped container, -1 if not mapped.
+    int mapped_fd_;
+    // Mapped container and its size in bytes.
+    char * mapped_data_;
+    std::size_t mapped_size_;
+    std::string mapped_filename_;
+    // Channels of the container and the address of their first column.
+    std::vector<LogChannel> mapped_channels_;
+    std::vector<double *> mapped_columns_;
+    double * mapped_timestamp_;
+    // Number of doubles between two consecutive columns.
+    std::size_t mapped_stride_;
+    // Samples dropped by record() since initMapped because the
+    // container was being saved.
+    boost::atomic<uint64_t> mapped_dropped_;
+
+    // Store one sample in the mapped container.
+    void recordMapped(DataToLog &aDataToLog, int64_t timestamp);
+    // Put the samples in chronological order and flush the mapping.
+    bool saveMapped();
+    // Release the mapping.
+    void unmap();
+    /// @}
 
     // Save one vector of information.
-    void saveVector(std::string &filename, 
+    bool saveVector(std::string &filename, 
 		    std::string &suffix,
 		    const std::vector<double> &avector,
 		    unsigned int);
 
+    // Save the channels not taken yet by another thread.
+    void saveChannels(std::string &fileName,
+		      std::vector<LogChannel> &channels,
+		      boost::atomic<std::size_t> &next,
+		      boost::atomic<bool> &ok);
+
+    // Body of the writer thread.
+    void saveThread();
+
+    /// @{ \name Streaming mode
+    // True if the samples are streamed to disk instead of being stored
+    // in the circular buffer.
+    bool streaming_;
+    // Lock-free queue between record() and the streaming thread.
+    boost::scoped_ptr<boost::lockfree::spsc_queue<double> > stream_queue_;
+    // Thread appending the samples to the stream file.
+    boost::thread stream_thread_;
+    // Keep streaming while true.
+    boost::atomic<bool> stream_running_;
+    // Set by saveAsync: the streaming thread updates the header of the
+    // file and syncs it to disk, then goes on.
+    boost::atomic<bool> stream_flush_;
+    // Number of samples pushed in and dropped from the queue.
+    boost::atomic<unsigned long> stream_recorded_;
+    boost::atomic<unsigned long> stream_dropped_;
+    // Sample being pushed, allocated at initialization.
+    std::vector<double> stream_sample_;
+    // Timestamp of the previous sample to compute dt.
+    int64_t stream_last_timestamp_;
+    // Name of the stream file.
+    std::string stream_filename_;
+
+    // Body of the streaming thread.
+    void streamThread();
+    // Push one sample in the queue.
+    void recordStream(DataToLog &aDataToLog, int64_t timestamp);
+    /// @}
+
   public:
   
     Log();
+    ~Log();
 
     void init(unsigned int nbDofs, unsigned int length);
+
+    /// Same as init but the circular buffer is a memory-mapped file
+    /// pre-sized for length samples, in the layout of the container
+    /// (see log-format.hh). Saving puts the samples in chronological
+    /// order in place and flushes the mapping to fileName.
+    /// The header is written here: the names of the joints and sensors
+    /// have to be set before. The file is sparse: its pages are allocated
+    /// when the samples reach them, or all at once by prefault().
+    bool initMapped(unsigned int nbDofs, unsigned int length,
+		    std::string &fileName);
+
+    /// Stream the samples to fileName+"-stream.log" instead of storing
+    /// them in the circular buffer. The memory used is bounded by the
+    /// capacity (in samples) of the queue towards the writer thread.
+    /// Each row holds t, dt, the motor angles, joint angles, velocities,
+    /// torques, motor currents, accelerometer, gyrometer, force sensors,
+    /// temperatures, duration, the time given to the controller
+    /// and the duration of each phase.
+    bool initStreaming(unsigned int nbDofs, std::string &fileName,
+		       unsigned int capacity);
+
     void record(DataToLog &aDataToLog);
 
-    void save(std::string &fileName);
+    /// Number of valid samples in the circular buffer.
+    unsigned long nbSamples() const;
+
+    /// Touch every page of the circular buffer (or of the mapped file)
+    /// so that record() does not page-fault. Returns the number of
+    /// bytes touched.
+    std::size_t prefault();
+
+    /// Select the layout of the saved log.
+    void setFormat(LogFormat format) { format_ = format; }
+    /// Compress the columns of the container without loss
+    /// (see log-codec.hh). Not used in the memory-mapped mode.
+    void setCompression(bool compression) { compression_ = compression; }
+    /// Number of threads writing the files of the channels concurrently.
+    void setSaveThreads(unsigned int nbThreads);
+    /// Names of the joints, in the order of the actuated state vector.
+    /// The names are used by the next save, or the next initMapped.
+    void setJointNames(const std::vector<std::string> &names);
+    /// Name of the IMU whose values are logged.
+    void setImuName(const std::string &name);
+    /// Names of the force sensors, in the order of the logged values.
+    void setForceSensorNames(const std::vector<std::string> &names);
+    /// Name the columns of the phases after the pipelined evaluation.
+    void setPipelined(bool pipelined) { pipelined_ = pipelined; }
+
+    bool save(std::string &fileName);
+
+    /// Save the log in a background thread and return immediately.
+    /// The writer thread saves a copy of the circular buffer, and the
+    /// recording goes on meanwhile. The oldest samples overwritten
+    /// during the copy are not saved.
+    /// The mapped container is reordered in place: the samples recorded
+    /// during the save are dropped, and counted in the header of the
+    /// container (see log-format.hh).
+    /// In streaming mode the stream file is only synced to disk, and
+    /// the samples recorded meanwhile are appended to it.
+    /// Returns false if a save is already running.
+    bool saveAsync(std::string &fileName);
+    /// Status of the last save.
+    SaveStatus saveStatus() const;
+    /// Wait for the end of the background save.
+    void waitSave();
+
+    /// True if the log is in streaming mode.
+    bool streaming() const { return streaming_; }
+    /// Number of samples streamed to the writer thread.
+    unsigned long streamedSamples() const;
+    /// Number of samples dropped because the writer thread was late.
+    unsigned long droppedSamples() const;
+
     void start_it();
+    /// Mark the end of a phase of the iteration. The phases are
+    /// expected in the order of LogPhase, between start_it and stop_it.
+    void phase_it(LogPhase phase) { time_phases_[phase] = monotonicNs(); }
     void stop_it();
+    /// Duration in ns between the last start_it and stop_it.
+    int64_t iterationDuration() const
+    { return time_stop_it_ - time_start_it_; }
 
   };
 }
@@ -2,6 +2,7 @@
 #include <iomanip>
 #include <dlfcn.h>
 #include <sstream>
+#include <algorithm>
 
 #include <pluginlib/class_list_macros.h>
 #include "roscontrol-sot-controller.hh"
@@ -69,19 +70,48 @@ namespace sot_controller
   {
     pid_controller.initParam(prefix);
   }
+
+  SensorBinding::SensorBinding():
+    data(NULL),
+    sensor(NULL)
+  {
+  }
    
   RCSotController::
   RCSotController():
     // Store 32 DoFs for 5 minutes (1 Khz: 5*60*1000)
     // -> 124 Mo of data.
+    log_filename_("/tmp/sot.log"),
+    log_mapped_(false),
     type_name_("RCSotController"),
     simulation_mode_(false),
     control_mode_(POSITION),
-    accumulated_time_(0.0),
+    effort_mode_pd_vectorized_(false),
     jitter_(0.0),
-    verbosity_level_(0)
+    verbosity_level_(0),
+    last_update_time_(0),
+    latency_publish_period_(1.0),
+    deadline_origin_(0),
+    latency_running_(false),
+    pipelined_(false),
+    pipeline_wait_(0),
+    pipeline_state_(PIPELINE_IDLE),
+    pipeline_running_(false),
+    pipeline_cleanup_(false),
+    command_(NULL)
   {
     RESETDEBUG4();
+    sem_init(&pipeline_request_,0,0);
+  }
+
+  RCSotController::
+  ~RCSotController()
+  {
+    stopPipeline();
+    sem_destroy(&pipeline_request_);
+    latency_running_.store(false);
+    if (latency_thread_.joinable())
+      latency_thread_.join();
   }
   
   void RCSotController::
@@ -135,26 +165,36 @@ namespace sot_controller
     if (!initInterfaces(robot_hw,robot_nh,controller_nh,claimed_resources))
       return false;
 
+    /// Bind the ros-control quantities to the SoT sensors and control.
+    initSensorsInBindings();
+    initControlBinding();
+
+    /// Publish the latencies of the control loop.
+    initLatencyPublisher(controller_nh);
+
     /// Create SoT
     SotLoaderBasic::Initialization();
 
+    /// The worker evaluating the SoT is created with its buffers here,
+    /// not from the control thread.
+    initPipeline();
+
+    /// Once everything is allocated, prepare for real-time execution.
+    initRealTime();
+
     /// If we are in effort mode then the device should not do any integration.
     if (control_mode_==EFFORT)
       {
 	sotController_->setNoIntegration();
 	/// Fill desired position during the phase where the robot is waiting.
-	for(unsigned int idJoint=0;idJoint<joints_.size();idJoint++)
+	for(unsigned int i=0;i<effort_mode_pd_joints_.size();i++)
 	  {
-	    std::string joint_name = joints_name_[idJoint];
-	    std::map<std::string,EffortControlPDMotorControlData>::iterator
-	      search_ecpd = effort_mode_pd_motors_.find(joint_name);
-	    
-	    if (search_ecpd!=effort_mode_pd_motors_.end())
-	      {
-		EffortControlPDMotorControlData & ecpdcdata =
-		  search_ecpd->second;
-		ecpdcdata.des_pos = joints_[idJoint].getPosition();
-	      }
+	    unsigned int idJoint = effort_mode_pd_joints_[i];
+	    effort_mode_pd_motors_[idJoint].des_pos =
+	      joints_[idJoint].getPosition();
+	    if (effort_mode_pd_vectorized_)
+	      effort_mode_pd_.setDesiredPosition
+		(i,effort_mode_pd_motors_[idJoint].des_pos);
 	  }
       }
     return true;
@@ -290,6 +330,19 @@ namespace sot_controller
     if (!initTemperatureSensors())
       return false;
 
+    /// Describe the logged quantities.
+    /// fillImu() leaves the values of the last IMU in the log.
+    RcSotLog.setJointNames(joints_name_);
+    if (!imu_sensor_.empty())
+      RcSotLog.setImuName(imu_sensor_.back().getName());
+    std::vector<std::string> ft_names;
+    for (unsigned i=0; i <ft_sensors_.size(); i++)
+      ft_names.push_back(ft_sensors_[i].getName());
+    RcSotLog.setForceSensorNames(ft_names);
+    RcSotLog.setPipelined(pipelined_);
+    if (log_mapped_ && !RcSotLog.initMapped(nbDofs_,300000,log_filename_))
+      RcSotLog.init(nbDofs_,300000);
+
     // Initialize ros node.
     int argc=1;
     char *argv[1];
@@ -363,13 +416,16 @@ namespace sot_controller
     		  xml_rpc_ecpd_init.getType(),XmlRpc::XmlRpcValue::TypeArray,XmlRpc::XmlRpcValue::TypeStruct);
        
        effort_mode_pd_motors_.clear();
+       effort_mode_pd_motors_.resize(joints_name_.size());
+       effort_mode_pd_joints_.clear();
        
        for (size_t i=0;i<joints_name_.size();i++)
          {
            if (xml_rpc_ecpd_init.hasMember(joints_name_[i]))
              {
                std::string prefix= "/sot_controller/effort_control_pd_motor_init/gains/" + joints_name_[i];
-               effort_mode_pd_motors_[joints_name_[i]].read_from_xmlrpc_value(prefix);
+               effort_mode_pd_motors_[i].read_from_xmlrpc_value(prefix);
+               effort_mode_pd_joints_.push_back(i);
              }
            else
     	     {
@@ -380,6 +436,22 @@ namespace sot_controller
     			joints_name_[i].c_str());
     	     }
          }
+
+       /// Optionally compute the control law of all the joints at once.
+       if (robot_nh.hasParam("/sot_controller/effort_control_pd_motor_init/vectorized"))
+         robot_nh.getParam("/sot_controller/effort_control_pd_motor_init/vectorized",
+                           effort_mode_pd_vectorized_);
+       if (effort_mode_pd_vectorized_)
+         {
+           if (verbosity_level_>0)
+             ROS_INFO("Vectorized PD controller for %ld joints",
+                      effort_mode_pd_joints_.size());
+           effort_mode_pd_.resize(effort_mode_pd_joints_.size());
+           for (unsigned int i=0;i<effort_mode_pd_joints_.size();i++)
+             effort_mode_pd_.setGains
+               (i,effort_mode_pd_motors_[effort_mode_pd_joints_[i]].
+                pid_controller.getGains());
+         }
        return true;
       }
     
@@ -461,12 +533,85 @@ namespace sot_controller
     nbDofs_ = joints_name_.size();
     /// Initialize the size of the data to store. 
     DataOneIter_.init(nbDofs_,1);
-    /// Initialize the data logger for 300s.
-    RcSotLog.init(nbDofs_,300000);
 	
     return true;
   }
 
+  void RCSotController::
+  readParamsLog(ros::NodeHandle &robot_nh)
+  {
+    /// In streaming mode the samples are written continuously
+    /// instead of keeping the last 300s in memory.
+    bool streaming=false;
+    if (robot_nh.hasParam("/sot_controller/log/streaming"))
+      robot_nh.getParam("/sot_controller/log/streaming",streaming);
+
+    if (streaming)
+      {
+	/// Size of the queue towards the writer thread (in samples).
+	int capacity=10000;
+	if (robot_nh.hasParam("/sot_controller/log/stream_capacity"))
+	  robot_nh.getParam("/sot_controller/log/stream_capacity",capacity);
+	if (verbosity_level_>0)
+	  ROS_INFO_STREAM("Streaming log to " << log_filename_
+			  << " with a capacity of " << capacity << " samples");
+	RcSotLog.initStreaming(nbDofs_,log_filename_,capacity);
+      }
+    else
+      {
+	/// The circular buffer can be a memory-mapped file in the
+	/// layout of the container. Its header holds the names of the
+	/// columns: it is created by init() once the sensors are known.
+	if (robot_nh.hasParam("/sot_controller/log/mmap"))
+	  robot_nh.getParam("/sot_controller/log/mmap",log_mapped_);
+
+	/// Initialize the data logger for 300s.
+	if (!log_mapped_)
+	  RcSotLog.init(nbDofs_,300000);
+      }
+
+    /// Write one file per channel (default) or a single columnar file.
+    std::string format;
+    if (robot_nh.hasParam("/sot_controller/log/format"))
+      {
+	robot_nh.getParam("/sot_controller/log/format",format);
+	if (format=="container")
+	  RcSotLog.setFormat(rc_sot_system::LOG_FORMAT_CONTAINER);
+	else if (format!="channels")
+	  ROS_WARN_STREAM("Unknown log format " << format
+			  << ", falls back to channels.");
+      }
+
+    /// Compress the columns of the container.
+    bool compression=false;
+    if (robot_nh.hasParam("/sot_controller/log/compression"))
+      robot_nh.getParam("/sot_controller/log/compression",compression);
+    RcSotLog.setCompression(compression);
+
+    /// Write the files of the channels from several threads.
+    int save_threads=1;
+    if (robot_nh.hasParam("/sot_controller/log/save_threads"))
+      robot_nh.getParam("/sot_controller/log/save_threads",save_threads);
+    RcSotLog.setSaveThreads(save_threads>0 ? (unsigned int)save_threads : 1);
+  }
+
+  void RCSotController::
+  readParamsLatency(ros::NodeHandle &robot_nh)
+  {
+    /// The percentiles are published at this period (in s).
+    if (robot_nh.hasParam("/sot_controller/latency/publish_period"))
+      robot_nh.getParam("/sot_controller/latency/publish_period",
+			latency_publish_period_);
+    /// A shorter period would keep the publisher busy next to the
+    /// control loop.
+    if (!(latency_publish_period_>=1e-3))
+      {
+	ROS_WARN_STREAM("latency/publish_period " << latency_publish_period_
+			<< " s is below 1 ms, 1 ms is used");
+	latency_publish_period_ = 1e-3;
+      }
+  }
+
   bool RCSotController::
   readParamsControlMode(ros::NodeHandle &robot_nh)
   {
@@ -517,6 +662,9 @@ namespace sot_controller
 	robot_nh.getParam("/sot_controller/dt",dt_);
 	if (verbosity_level_>0)
 	  ROS_INFO_STREAM("dt: " << dt_);
+	/// The SoT is evaluated every dt in integer ns.
+	sot_scheduler_.setPeriod((int64_t)(1e9*dt_+0.5),
+				 (int64_t)(1e9*jitter_+0.5));
 	return true;
       }
 
@@ -524,6 +672,55 @@ namespace sot_controller
     return false;
   }
 
+  void RCSotController::
+  readParamsDeadline(ros::NodeHandle &robot_nh)
+  {
+    /// An iteration is late if it starts more than dt + jitter + tolerance
+    /// after the previous one. The tolerance defaults to a tenth of dt.
+    double tolerance = 0.1*dt_;
+    if (robot_nh.hasParam("/sot_controller/deadline/tolerance"))
+      robot_nh.getParam("/sot_controller/deadline/tolerance",tolerance);
+    deadline_monitor_.setDeadline((int64_t)(1e9*dt_),
+				  (int64_t)(1e9*(jitter_+tolerance)));
+  }
+
+  void RCSotController::
+  readParamsPipeline(ros::NodeHandle &robot_nh)
+  {
+    if (robot_nh.hasParam("/sot_controller/pipeline/enabled"))
+      robot_nh.getParam("/sot_controller/pipeline/enabled",pipelined_);
+
+    /// Time given to the worker to finish before the command is reused.
+    double wait=0.0;
+    if (robot_nh.hasParam("/sot_controller/pipeline/wait"))
+      robot_nh.getParam("/sot_controller/pipeline/wait",wait);
+    pipeline_wait_ = (int64_t)(1e9*wait);
+
+    if (pipelined_ && verbosity_level_>0)
+      ROS_INFO_STREAM("The SoT is evaluated on a worker thread, wait: "
+		      << wait << " s");
+  }
+
+  void RCSotController::
+  readParamsRealTime(ros::NodeHandle &robot_nh)
+  {
+    if (robot_nh.hasParam("/sot_controller/rt/lock_memory"))
+      robot_nh.getParam("/sot_controller/rt/lock_memory",
+			rt_setup_.lock_memory);
+    if (robot_nh.hasParam("/sot_controller/rt/prefault_log"))
+      robot_nh.getParam("/sot_controller/rt/prefault_log",
+			rt_setup_.prefault_log);
+    if (robot_nh.hasParam("/sot_controller/rt/prefault_stack"))
+      robot_nh.getParam("/sot_controller/rt/prefault_stack",
+			rt_setup_.prefault_stack);
+    if (robot_nh.hasParam("/sot_controller/rt/worker_cpu"))
+      robot_nh.getParam("/sot_controller/rt/worker_cpu",
+			rt_setup_.worker_cpu);
+    if (robot_nh.hasParam("/sot_controller/rt/worker_priority"))
+      robot_nh.getParam("/sot_controller/rt/worker_priority",
+			rt_setup_.worker_priority);
+  }
+
   bool RCSotController::
   readUrdf(ros::NodeHandle &robot_nh)
   {
@@ -569,6 +766,10 @@ namespace sot_controller
     if (!readParamsJointNames(robot_nh))
       return false;
 
+    /// Initialize the log.
+    readParamsLog(robot_nh);
+    readParamsLatency(robot_nh);
+
     /// Calls readParamsControlMode.
     // Defines if the control mode is position or effort
     readParamsControlMode(robot_nh);
@@ -580,6 +781,9 @@ namespace sot_controller
     /// Get control perioud
     if (!readParamsdt(robot_nh))
       return false;
+    readParamsDeadline(robot_nh);
+    readParamsPipeline(robot_nh);
+    readParamsRealTime(robot_nh);
     
     if (control_mode_==EFFORT)
       readParamsEffortControlPDMotorControlData(robot_nh);
@@ -659,6 +863,17 @@ namespace sot_controller
       // sensor handle on imu
       imu_sensor_.push_back(imu_iface_->getHandle(imu_iface_names[i]));
     }
+
+    // Resolve the labels of the IMUs in the SoT sensors once for all.
+    imu_sensors_bindings_.clear();
+    for (unsigned i=0; i <imu_sensor_.size(); i++){
+      imu_sensors_bindings_.push_back
+	(bindSensorsImu("orientation_",i,DataOneIter_.orientation));
+      imu_sensors_bindings_.push_back
+	(bindSensorsImu("gyrometer_",i,DataOneIter_.gyrometer));
+      imu_sensors_bindings_.push_back
+	(bindSensorsImu("accelerometer_",i,DataOneIter_.accelerometer));
+    }
  
     return true ;
   }
@@ -707,20 +922,57 @@ namespace sot_controller
     return true;
   }
   
-  void RCSotController::
-  fillSensorsIn(std::string &title, std::vector<double> & data)
+  SensorBinding RCSotController::
+  bindSensorsIn(const std::string &title, std::vector<double> &data)
   {
+    SensorBinding abinding;
+    abinding.data = &data;
+
     /// Tries to find the mapping from the local validation
     /// to the SoT device.
     it_map_rt_to_sot it_mapRC2Sot= mapFromRCToSotDevice_.find(title);
     /// If the mapping is found
     if (it_mapRC2Sot!=mapFromRCToSotDevice_.end())
       {
-	/// Expose the data to the SoT device.
-	std::string lmapRC2Sot = it_mapRC2Sot->second;
-	sensorsIn_[lmapRC2Sot].setName(lmapRC2Sot);
-	sensorsIn_[lmapRC2Sot].setValues(data);
+	/// Create the entry once for all and size it to avoid
+	/// any allocation when the data are exposed to the SoT device.
+	const std::string & lmapRC2Sot = it_mapRC2Sot->second;
+	abinding.sensor = &sensorsIn_[lmapRC2Sot];
+	abinding.sensor->setName(lmapRC2Sot);
+	abinding.sensor->setValues(data);
+	if (verbosity_level_>0)
+	  ROS_INFO_STREAM("Bind " << title << " to " << lmapRC2Sot);
       }
+    return abinding;
+  }
+
+  void RCSotController::
+  initSensorsInBindings()
+  {
+    joints_sensors_bindings_.clear();
+    joints_sensors_bindings_.push_back
+      (bindSensorsIn("motor-angles",DataOneIter_.motor_angle));
+    joints_sensors_bindings_.push_back
+      (bindSensorsIn("joint-angles",DataOneIter_.joint_angle));
+    joints_sensors_bindings_.push_back
+      (bindSensorsIn("velocities",DataOneIter_.velocities));
+    joints_sensors_bindings_.push_back
+      (bindSensorsIn("torques",DataOneIter_.torques));
+    joints_sensors_bindings_.push_back
+      (bindSensorsIn("currents",DataOneIter_.motor_currents));
+
+    force_sensors_binding_ =
+      bindSensorsIn("forces",DataOneIter_.force_sensors);
+    temp_sensors_binding_ =
+      bindSensorsIn("act-temp",DataOneIter_.temperatures);
+  }
+
+  void RCSotController::
+  fillSensorsIn(SensorBinding &binding)
+  {
+    /// Expose the data to the SoT device if the quantity is mapped.
+    if (binding.sensor!=NULL)
+      binding.sensor->setValues(*binding.data);
   }
 
   void RCSotController::
@@ -743,27 +995,20 @@ namespace sot_controller
       }
     
     /// Update SoT internal values
-    std::string ltitle("motor-angles"); 
-    fillSensorsIn(ltitle,DataOneIter_.motor_angle);
-    ltitle = "joint-angles";
-    fillSensorsIn(ltitle,DataOneIter_.joint_angle);
-    ltitle = "velocities";
-    fillSensorsIn(ltitle,DataOneIter_.velocities);
-    ltitle = "torques";
-    fillSensorsIn(ltitle,DataOneIter_.torques);
-    ltitle = "currents";
-    fillSensorsIn(ltitle,DataOneIter_.motor_currents);
-    
+    for(unsigned int idBinding=0;
+	idBinding<joints_sensors_bindings_.size();
+	idBinding++)
+      fillSensorsIn(joints_sensors_bindings_[idBinding]);
   }
 
-  void RCSotController::setSensorsImu(std::string &name,
-					   int IMUnb,
-					   std::vector<double> & data)
+  SensorBinding RCSotController::
+  bindSensorsImu(const std::string &name,
+		 int IMUnb,
+		 std::vector<double> & data)
   {
     std::ostringstream labelOss;
     labelOss << name << IMUnb;
-    std::string label_s = labelOss.str();
-    fillSensorsIn(label_s,data);
+    return bindSensorsIn(labelOss.str(),data);
   }
 
   void RCSotController::
@@ -797,15 +1042,12 @@ namespace sot_controller
 		  imu_sensor_[idIMU].getLinearAcceleration()[idlinacc];
 	      }
 	  }
-	
-	std::string orientation_s("orientation_");
-	setSensorsImu(orientation_s, idIMU, DataOneIter_.orientation);
-
-	std::string gyrometer_s("gyrometer_");
-	setSensorsImu(gyrometer_s, idIMU, DataOneIter_.gyrometer);
 
-	std::string accelerometer_s("accelerometer_");
-	setSensorsImu(accelerometer_s, idIMU, DataOneIter_.accelerometer);
+	/// The data of this IMU are exposed before being overwritten
+	/// by the next one.
+	fillSensorsIn(imu_sensors_bindings_[3*idIMU]);
+	fillSensorsIn(imu_sensors_bindings_[3*idIMU+1]);
+	fillSensorsIn(imu_sensors_bindings_[3*idIMU+2]);
       }
   }
   
@@ -823,9 +1065,8 @@ namespace sot_controller
 	    ft_sensors_[idFS].getTorque()[idTorque];
       }
 
-    
-    std::string alabel("forces");
-    fillSensorsIn(alabel,DataOneIter_.force_sensors);
+
+    fillSensorsIn(force_sensors_binding_);
   }
 
   void RCSotController::
@@ -846,8 +1087,7 @@ namespace sot_controller
 	  DataOneIter_.temperatures[idFS]=  0.0;
       }
 
-    std::string alabel("act-temp");
-    fillSensorsIn(alabel,DataOneIter_.temperatures);
+    fillSensorsIn(temp_sensors_binding_);
   }
 
   void RCSotController::
@@ -860,30 +1100,43 @@ namespace sot_controller
   }
   
   void RCSotController::
-  readControl(std::map<std::string,dgs::ControlValues> &controlValues)
+  initControlBinding()
   {
-    ODEBUG4("joints_.size() = " << joints_.size());
-	    
     std::string cmdTitle;
     if (control_mode_==POSITION)
       cmdTitle="cmd-joints";
     else if (control_mode_==EFFORT)
       cmdTitle="cmd-effort";
 
+    command_ = NULL;
     it_map_rt_to_sot it_mapRC2Sot= mapFromRCToSotDevice_.find(cmdTitle);
     if (it_mapRC2Sot!=mapFromRCToSotDevice_.end())
       {
-	std::string lmapRC2Sot = it_mapRC2Sot->second;
-	command_ = controlValues[lmapRC2Sot].getValues();
-	ODEBUG4("angleControl_.size() = " << command_.size());
-	for(unsigned int i=0;
-	    i<command_.size();++i)
-	  {
-	    joints_[i].setCommand(command_[i]);
-	  }
+	/// The entry is created here so that the SoT device fills
+	/// the same node of the map at each iteration.
+	const std::string & lmapRC2Sot = it_mapRC2Sot->second;
+	command_ = &controlValues_[lmapRC2Sot];
+	if (verbosity_level_>0)
+	  ROS_INFO_STREAM("Bind " << cmdTitle << " to " << lmapRC2Sot);
       }
   }
 
+  void RCSotController::
+  readControl()
+  {
+    ODEBUG4("joints_.size() = " << joints_.size());
+
+    if (command_==NULL)
+      return;
+
+    /// Read the values in place from the SoT device output.
+    const std::vector<double> & lcommand = command_->getValues();
+    ODEBUG4("angleControl_.size() = " << lcommand.size());
+    std::size_t nbCommands = std::min(lcommand.size(),joints_.size());
+    for(std::size_t i=0;i<nbCommands;++i)
+      joints_[i].setCommand(lcommand[i]);
+  }
+
   void RCSotController::one_iteration()
   {
     // Chrono start
@@ -891,52 +1144,216 @@ namespace sot_controller
     
     /// Update the sensors.
     fillSensors();
+    RcSotLog.phase_it(rc_sot_system::PHASE_FILL_SENSORS);
 
     /// Generate a control law.
     try
       {
 	sotController_->nominalSetSensors(sensorsIn_);
+	RcSotLog.phase_it(rc_sot_system::PHASE_SET_SENSORS);
 	sotController_->getControl(controlValues_);
+	RcSotLog.phase_it(rc_sot_system::PHASE_GET_CONTROL);
       }
     catch(std::exception &e) { throw e;}
 
     /// Read the control values
-    readControl(controlValues_);
+    readControl();
+    RcSotLog.phase_it(rc_sot_system::PHASE_READ_CONTROL);
     
     // Chrono stop.
     RcSotLog.stop_it();
+    duration_histogram_.record(RcSotLog.iterationDuration());
     
     /// Store everything in Log.
     RcSotLog.record(DataOneIter_);
   }
 
+  void RCSotController::one_iteration_pipelined()
+  {
+    // Chrono start
+    RcSotLog.start_it();
+
+    /// Update the sensors.
+    fillSensors();
+    RcSotLog.phase_it(rc_sot_system::PHASE_FILL_SENSORS);
+
+    /// Wait a bounded time for the evaluation started at the previous
+    /// iteration.
+    int64_t deadline = rc_sot_system::monotonicNs()+pipeline_wait_;
+    while (pipeline_state_.load(boost::memory_order_acquire)==PIPELINE_BUSY
+	   && rc_sot_system::monotonicNs()<deadline)
+      ;
+    RcSotLog.phase_it(rc_sot_system::PHASE_SET_SENSORS);
+
+    int state = pipeline_state_.load(boost::memory_order_acquire);
+    if (state!=PIPELINE_BUSY)
+      {
+	/// The worker is idle: take its command and give it the snapshot.
+	if (state==PIPELINE_DONE && command_!=NULL)
+	  {
+	    const std::vector<double> & lcommand = command_->getValues();
+	    std::size_t nbCommands = std::min(lcommand.size(),
+					      pipeline_command_.size());
+	    std::copy(lcommand.begin(),lcommand.begin()+nbCommands,
+		      pipeline_command_.begin());
+	  }
+	for(std::size_t i=0;i<pipeline_bindings_.size();i++)
+	  pipeline_bindings_[i].second->setValues
+	    (pipeline_bindings_[i].first->getValues());
+	pipeline_state_.store(PIPELINE_BUSY,boost::memory_order_release);
+	sem_post(&pipeline_request_);
+      }
+    else
+      /// Apply the last command again.
+      deadline_monitor_.workerMiss(last_update_time_);
+    RcSotLog.phase_it(rc_sot_system::PHASE_GET_CONTROL);
+
+    for(std::size_t i=0;i<pipeline_command_.size();++i)
+      joints_[i].setCommand(pipeline_command_[i]);
+    RcSotLog.phase_it(rc_sot_system::PHASE_READ_CONTROL);
+
+    // Chrono stop.
+    RcSotLog.stop_it();
+    duration_histogram_.record(RcSotLog.iterationDuration());
+
+    /// Store everything in Log.
+    RcSotLog.record(DataOneIter_);
+  }
+
+  void RCSotController::initRealTime()
+  {
+    if (rt_setup_.lock_memory)
+      lockMemory();
+    if (rt_setup_.prefault_log)
+      ROS_INFO_STREAM("RT setup: " << RcSotLog.prefault()
+		      << " bytes of log touched");
+    if (!pipelined_ &&
+	(rt_setup_.worker_cpu>=0 || rt_setup_.worker_priority>0))
+      ROS_WARN_STREAM("RT setup: no worker thread, the pipeline is disabled");
+  }
+
+  void RCSotController::initPipeline()
+  {
+    if (!pipelined_ || pipeline_thread_.joinable())
+      return;
+
+    /// The snapshot has the same entries as sensorsIn_, filled once so
+    /// that copying the values does not allocate.
+    fillSensors();
+    pipeline_sensors_ = sensorsIn_;
+    pipeline_bindings_.clear();
+    std::map<std::string,dgs::SensorValues>::iterator it_src, it_dst;
+    for(it_src=sensorsIn_.begin(), it_dst=pipeline_sensors_.begin();
+	it_src!=sensorsIn_.end(); ++it_src, ++it_dst)
+      pipeline_bindings_.push_back(std::make_pair(&it_src->second,
+						  &it_dst->second));
+    pipeline_command_.resize(joints_.size());
+
+    pipeline_state_.store(PIPELINE_IDLE);
+    pipeline_running_.store(true);
+    pipeline_thread_ = boost::thread(&RCSotController::pipelineThread,this);
+    if (rt_setup_.worker_cpu>=0)
+      setThreadAffinity(pipeline_thread_.native_handle(),
+			rt_setup_.worker_cpu,"SoT worker");
+    if (rt_setup_.worker_priority>0)
+      setThreadPriority(pipeline_thread_.native_handle(),
+			rt_setup_.worker_priority,"SoT worker");
+  }
+
+  void RCSotController::resetPipeline()
+  {
+    if (!pipeline_thread_.joinable())
+      return;
+    /// Until the first result, the joints keep their current command.
+    for(std::size_t i=0;i<joints_.size();i++)
+      pipeline_command_[i] = joints_[i].getCommand();
+    pipeline_cleanup_.store(false);
+    /// An evaluation left over by the last stop is not applied.
+    int done = PIPELINE_DONE;
+    pipeline_state_.compare_exchange_strong(done,PIPELINE_IDLE);
+  }
+
+  void RCSotController::stopPipeline()
+  {
+    if (!pipeline_thread_.joinable())
+      return;
+    pipeline_running_.store(false);
+    sem_post(&pipeline_request_);
+    pipeline_thread_.join();
+    while (sem_trywait(&pipeline_request_)==0)
+      ;
+  }
+
+  void RCSotController::cleanupSot()
+  {
+    SotLoaderBasic::CleanUp();
+
+    using namespace ::dynamicgraph;
+    RealTimeLogger::destroy();
+  }
+
+  void RCSotController::pipelineThread()
+  {
+    while (true)
+      {
+	if (sem_wait(&pipeline_request_)!=0)
+	  continue;
+	if (!pipeline_running_.load())
+	  break;
+	try
+	  {
+	    sotController_->nominalSetSensors(pipeline_sensors_);
+	    sotController_->getControl(controlValues_);
+	  }
+	catch(std::exception &e)
+	  {
+	    ROS_ERROR_STREAM("Failure of the SoT worker: " << e.what());
+	  }
+	catch(...)
+	  {
+	    ROS_ERROR_STREAM("Failure of the SoT worker: unknown exception");
+	  }
+	pipeline_state_.store(PIPELINE_DONE);
+	/// stopping() found the worker busy: release the SoT here.
+	if (pipeline_cleanup_.exchange(false))
+	  cleanupSot();
+      }
+  }
+
   void RCSotController::
   localStandbyEffortControlMode(const ros::Duration& period)
   {
-    // ROS_INFO("Compute command for effort mode: %d %d",joints_.size(),effort_mode_pd_motors_.size());
-    for(unsigned int idJoint=0;idJoint<joints_.size();idJoint++)
+    // ROS_INFO("Compute command for effort mode: %d %d",joints_.size(),effort_mode_pd_joints_.size());
+    if (effort_mode_pd_vectorized_)
       {
-	std::string joint_name = joints_name_[idJoint];
-	std::map<std::string,EffortControlPDMotorControlData>::iterator
-	  search_ecpd = effort_mode_pd_motors_.find(joint_name);
-             
-	if (search_ecpd!=effort_mode_pd_motors_.end())
+	for(unsigned int i=0;i<effort_mode_pd_joints_.size();i++)
 	  {
-	    EffortControlPDMotorControlData & ecpdcdata =
-	      search_ecpd->second;
-	    double vel_err = 0 - joints_[idJoint].getVelocity();
-	    double err = ecpdcdata.des_pos - joints_[idJoint].getPosition();
-            
-	    ecpdcdata.integ_err +=err;
-	    
-	    double local_command = ecpdcdata.pid_controller.computeCommand(err,vel_err,period);
-	    // Apply command
-	    control_toolbox::Pid::Gains gains = ecpdcdata.pid_controller.getGains();
-	    joints_[idJoint].setCommand(local_command);
-            
-	    // Update previous value.
-	    ecpdcdata.prev = DataOneIter_.motor_angle[idJoint];
+	    unsigned int idJoint = effort_mode_pd_joints_[i];
+	    effort_mode_pd_.setState(i,joints_[idJoint].getPosition(),
+				     joints_[idJoint].getVelocity());
 	  }
+	effort_mode_pd_.computeCommand(period.toSec());
+	for(unsigned int i=0;i<effort_mode_pd_joints_.size();i++)
+	  joints_[effort_mode_pd_joints_[i]].setCommand(effort_mode_pd_.command(i));
+	return;
+      }
+
+    for(unsigned int i=0;i<effort_mode_pd_joints_.size();i++)
+      {
+	unsigned int idJoint = effort_mode_pd_joints_[i];
+	EffortControlPDMotorControlData & ecpdcdata =
+	  effort_mode_pd_motors_[idJoint];
+	double vel_err = 0 - joints_[idJoint].getVelocity();
+	double err = ecpdcdata.des_pos - joints_[idJoint].getPosition();
+
+	ecpdcdata.integ_err +=err;
+
+	double local_command = ecpdcdata.pid_controller.computeCommand(err,vel_err,period);
+	// Apply command
+	joints_[idJoint].setCommand(local_command);
+
+	// Update previous value.
+	ecpdcdata.prev = DataOneIter_.motor_angle[idJoint];
       }
   }
   
@@ -964,21 +1381,32 @@ namespace sot_controller
   }
   
   void RCSotController::
-  update(const ros::Time&, const ros::Duration& period)
+  update(const ros::Time& time, const ros::Duration& period)
    {
+    int64_t now = rc_sot_system::monotonicNs();
+    if (last_update_time_>0)
+      period_histogram_.record(now-last_update_time_);
+    last_update_time_ = now;
+
     // Do not send any control if the dynamic graph is not started
      if (!isDynamicGraphStopped())
       {
        try
          {
-	   double periodInSec = period.toSec();
-	   if (periodInSec+accumulated_time_>dt_-jitter_)
+	   if (sot_scheduler_.update(period.toNSec()))
 	     {
-	       one_iteration();
-	       accumulated_time_ = 0.0;
+	       DataOneIter_.ros_time[0] = time.toSec();
+	       if (pipelined_)
+		 one_iteration_pipelined();
+	       else
+		 one_iteration();
+	       /// Without decimation the ticks are spread over one more
+	       /// hardware period.
+	       int64_t spread = sot_scheduler_.decimation()>0 ? 0 :
+		 sot_scheduler_.meanHardwarePeriod();
+	       deadline_monitor_.check(now,RcSotLog.iterationDuration(),
+				       spread);
 	     }
-	   else
-	     accumulated_time_ += periodInSec;
          }
        catch (std::exception const &exc)
          {
@@ -1009,21 +1437,118 @@ namespace sot_controller
     using namespace ::dynamicgraph;
     RealTimeLogger::instance().addOutputStream(LoggerStreamPtr_t(new LoggerROSStream()));
 
+    duration_histogram_.reset();
+    period_histogram_.reset();
+    last_update_time_ = 0;
+    deadline_monitor_.reset();
+    deadline_origin_ = rc_sot_system::monotonicNs();
+    sot_scheduler_.reset();
+
+    /// starting is called from the control thread.
+    if (rt_setup_.prefault_stack>0)
+      prefaultStack((std::size_t)rt_setup_.prefault_stack);
+
+    resetPipeline();
+
     fillSensors();
   }
     
   void RCSotController::
   stopping(const ros::Time &)
   {
-    std::string afilename("/tmp/sot.log");
-    RcSotLog.save(afilename);
-
-    SotLoaderBasic::CleanUp();
-
-    using namespace ::dynamicgraph;
-    RealTimeLogger::destroy();
+    LatencySummary duration, period;
+    duration_histogram_.summary(duration);
+    period_histogram_.summary(period);
+    ROS_INFO_STREAM("Iteration duration: " << duration.str());
+    ROS_INFO_STREAM("Update period: " << period.str());
+    DeadlineStats deadlines;
+    deadline_monitor_.stats(deadlines);
+    ROS_INFO_STREAM("Deadlines: " << deadlines.str(deadline_origin_));
+    ROS_INFO_STREAM("SoT rate: " << sot_scheduler_.achievedRate()
+		    << " Hz for " << 1.0/dt_ << " Hz, "
+		    << sot_scheduler_.ticks() << " iterations, "
+		    << sot_scheduler_.skipped() << " skipped");
+
+    /// The log is written by a background thread to avoid stalling
+    /// the controller manager.
+    if (!RcSotLog.saveAsync(log_filename_))
+      ROS_WARN_STREAM("A previous save of the log is still running, "
+		      << log_filename_ << " is not written.");
+
+    /// The worker may still be evaluating the SoT: it is not waited
+    /// for on the control thread. Whichever of the control thread and
+    /// the worker sees the worker idle releases the SoT.
+    if (pipeline_thread_.joinable())
+      {
+	pipeline_cleanup_.store(true);
+	if (pipeline_state_.load()!=PIPELINE_BUSY &&
+	    pipeline_cleanup_.exchange(false))
+	  cleanupSot();
+      }
+    else
+      cleanupSot();
   }
   
+  void RCSotController::
+  initLatencyPublisher(ros::NodeHandle &controller_nh)
+  {
+    if (latency_thread_.joinable())
+      return;
+
+    latency_publisher_.reset
+      (new realtime_tools::RealtimePublisher<std_msgs::Float64MultiArray>
+       (controller_nh,"latency",1));
+    std_msgs::Float64MultiArray &msg = latency_publisher_->msg_;
+    msg.layout.dim.resize(2);
+    msg.layout.dim[0].label = "duration,period";
+    msg.layout.dim[0].size = 2;
+    msg.layout.dim[0].stride = 10;
+    msg.layout.dim[1].label = "count,p50,p99,p99.9,max [us]";
+    msg.layout.dim[1].size = 5;
+    msg.layout.dim[1].stride = 5;
+    msg.data.resize(10,0.0);
+
+    deadline_publisher_.reset
+      (new realtime_tools::RealtimePublisher<std_msgs::String>
+       (controller_nh,"deadline_misses",1));
+
+    latency_running_.store(true);
+    latency_thread_ = boost::thread(&RCSotController::latencyThread,this);
+  }
+
+  void RCSotController::
+  latencyThread()
+  {
+    const LatencyHistogram * histograms[2] =
+      { &duration_histogram_, &period_histogram_ };
+    const long period_us = (long)(1e6*latency_publish_period_);
+    while (latency_running_.load())
+      {
+	boost::this_thread::sleep(boost::posix_time::microseconds(period_us));
+	if (!latency_publisher_->trylock())
+	  continue;
+	std::vector<double> &data = latency_publisher_->msg_.data;
+	for(unsigned int i=0;i<2;i++)
+	  {
+	    LatencySummary summary;
+	    histograms[i]->summary(summary);
+	    data[5*i] = (double)summary.count;
+	    data[5*i+1] = 1e-3*(double)summary.p50;
+	    data[5*i+2] = 1e-3*(double)summary.p99;
+	    data[5*i+3] = 1e-3*(double)summary.p999;
+	    data[5*i+4] = 1e-3*(double)summary.max;
+	  }
+	latency_publisher_->unlockAndPublish();
+
+	if (!deadline_publisher_->trylock())
+	  continue;
+	DeadlineStats deadlines;
+	deadline_monitor_.stats(deadlines);
+	deadline_publisher_->msg_.data = deadlines.str(deadline_origin_);
+	deadline_publisher_->unlockAndPublish();
+      }
+  }
+
   std::string RCSotController::
   getHardwareInterfaceType() const
   {
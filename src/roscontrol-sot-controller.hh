@@ -37,6 +37,7 @@
 
 #include <string>
 #include <map>
+#include <semaphore.h>
 
 #include <controller_interface/controller.h>
 #include <hardware_interface/joint_command_interface.h>
@@ -52,12 +53,27 @@
 #include <urdf_parser/urdf_parser.h>
 
 /* Local header */
+#include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <realtime_tools/realtime_publisher.h>
+#include <std_msgs/Float64MultiArray.h>
+#include <std_msgs/String.h>
+
 #include "log.hh"
+#include "standby-pd-controller.hh"
+#include "latency-histogram.hh"
+#include "deadline-monitor.hh"
+#include "subsampling-scheduler.hh"
+#include "rt-setup.hh"
 
 namespace sot_controller 
 {
   enum SotControlMode { POSITION, EFFORT};
 
+  /// State of the evaluation of the SoT by the pipeline worker.
+  enum PipelineState { PIPELINE_IDLE, PIPELINE_BUSY, PIPELINE_DONE };
+
   class XmlrpcHelperException : public ros::Exception
   {
   public:
@@ -81,6 +97,20 @@ namespace sot_controller
     void read_from_xmlrpc_value(const std::string &prefix);
   };
 
+  /// \brief Binding between a ros-control quantity stored in the data log
+  /// and its slot in the map of the SoT sensors.
+  /// It is resolved once at initialization to avoid string handling
+  /// and map look-ups at each iteration.
+  struct SensorBinding
+  {
+    /// Values read from the ros-control handles.
+    std::vector<double> * data;
+    /// Entry exposed to the SoT device, NULL if the quantity is not mapped.
+    dgs::SensorValues * sensor;
+
+    SensorBinding();
+  };
+
 #ifndef CONTROLLER_INTERFACE_KINETIC
   typedef std::set<std::string> ClaimedResources;
 #endif 
@@ -141,6 +171,12 @@ namespace sot_controller
 
     /// \brief Log
     rc_sot_system::Log RcSotLog;
+
+    /// \brief Prefix of the log files.
+    std::string log_filename_;
+    /// \brief Back the log by a memory-mapped container. It is created
+    /// by init() once the names of the columns are known.
+    bool log_mapped_;
     /// @}
     
     const std::string type_name_;
@@ -152,8 +188,18 @@ namespace sot_controller
     SotControlMode control_mode_;
     
     /// \brief Implement a PD controller for the robot when the dynamic graph
-    /// is not on.
-    std::map<std::string, EffortControlPDMotorControlData> effort_mode_pd_motors_;
+    /// is not on. This vector is aligned with joints_.
+    std::vector<EffortControlPDMotorControlData> effort_mode_pd_motors_;
+
+    /// \brief Indexes of the joints having gains for the PD controller.
+    std::vector<unsigned int> effort_mode_pd_joints_;
+
+    /// \brief Compute the PD control law of all the joints in one pass
+    /// instead of calling each control_toolbox::Pid.
+    bool effort_mode_pd_vectorized_;
+
+    /// \brief Vectorized PD controller, aligned with effort_mode_pd_joints_.
+    StandbyPDController effort_mode_pd_;
 
     /// \brief Give the desired position when the dynamic graph is not on.
     std::vector<double> desired_init_pose_;
@@ -170,7 +216,7 @@ namespace sot_controller
     std::map<std::string,std::string> mapFromRCToSotDevice_;
 
     /// To be able to subsample control period.
-    double accumulated_time_;
+    SubsamplingScheduler sot_scheduler_;
 
     /// Jitter for the subsampling.
     double jitter_;
@@ -182,9 +228,63 @@ namespace sot_controller
     /// URDF model of the robot.
     urdf::ModelInterfaceSharedPtr modelURDF_;    
 
+    /// @{ \name Latency monitoring
+    /// \brief Duration of one_iteration.
+    LatencyHistogram duration_histogram_;
+    /// \brief Period between two calls to update.
+    LatencyHistogram period_histogram_;
+    /// \brief Monotonic time of the last call to update, 0 before the first.
+    int64_t last_update_time_;
+    /// \brief Period of the publication of the percentiles in s.
+    double latency_publish_period_;
+    /// \brief Publish the percentiles of the histograms in microseconds.
+    boost::scoped_ptr<realtime_tools::RealtimePublisher
+		      <std_msgs::Float64MultiArray> > latency_publisher_;
+    /// \brief Missed deadlines of the iterations of the SoT.
+    DeadlineMonitor deadline_monitor_;
+    /// \brief Monotonic time of starting, origin of the times of the misses.
+    int64_t deadline_origin_;
+    /// \brief Publish the dump of the missed deadlines.
+    boost::scoped_ptr<realtime_tools::RealtimePublisher
+		      <std_msgs::String> > deadline_publisher_;
+    /// \brief Non real-time thread computing the percentiles
+    /// and publishing the missed deadlines.
+    boost::thread latency_thread_;
+    boost::atomic<bool> latency_running_;
+    /// @}
+
+    /// @{ \name Pipelined evaluation of the SoT
+    /// \brief Evaluate the SoT on a worker thread, the command being
+    /// applied one iteration later.
+    bool pipelined_;
+    /// \brief Maximal time (in ns) update waits for the worker before
+    /// applying the last command again.
+    int64_t pipeline_wait_;
+    /// \brief Snapshot of the sensors read by the worker.
+    std::map<std::string,dgs::SensorValues> pipeline_sensors_;
+    /// \brief Copy of each entry of sensorsIn_ to pipeline_sensors_.
+    std::vector<std::pair<const dgs::SensorValues *,
+			  dgs::SensorValues *> > pipeline_bindings_;
+    /// \brief Last command computed by the worker.
+    std::vector<double> pipeline_command_;
+    /// \brief PipelineState, shared with the worker.
+    boost::atomic<int> pipeline_state_;
+    /// \brief Signal a new snapshot to the worker.
+    sem_t pipeline_request_;
+    boost::thread pipeline_thread_;
+    boost::atomic<bool> pipeline_running_;
+    /// \brief Set by stopping(): the SoT is released by the control
+    /// thread if the worker is idle, by the worker otherwise.
+    boost::atomic<bool> pipeline_cleanup_;
+    /// @}
+
+    /// \brief Real-time preparation of the process and of the threads.
+    RealTimeSetup rt_setup_;
+
   public :
 
     RCSotController ();
+    ~RCSotController ();
 
     /// \brief Read the configuration files, 
     /// claims the request to the robot and initialize the Stack-Of-Tasks.
@@ -210,6 +310,10 @@ namespace sot_controller
     virtual std::string getHardwareInterfaceType() const;
 
   protected:
+    /// Scheduler of the SoT iterations, for its statistics.
+    const SubsamplingScheduler & sotScheduler() const
+    { return sot_scheduler_; }
+
     /// Initialize the roscontrol interfaces
     bool initInterfaces(lhi::RobotHW * robot_hw,
 			ros::NodeHandle &,
@@ -254,19 +358,41 @@ namespace sot_controller
 
     /// \brief Read verbosity level to display messages mostly during initialization
     void readParamsVerbosityLevel(ros::NodeHandle &robot_nh);
+
+    /// \brief Read the log configuration and initialize the log.
+    void readParamsLog(ros::NodeHandle &robot_nh);
+
+    /// \brief Read the period of the publication of the latencies.
+    void readParamsLatency(ros::NodeHandle &robot_nh);
+
+    /// \brief Set the deadline of an iteration from dt_.
+    void readParamsDeadline(ros::NodeHandle &robot_nh);
+
+    /// \brief Read if the SoT is evaluated on a worker thread.
+    void readParamsPipeline(ros::NodeHandle &robot_nh);
+
+    /// \brief Read the real-time preparation steps.
+    void readParamsRealTime(ros::NodeHandle &robot_nh);
     ///@}
 
-    /// \brief Fill the SoT map structures
-    void fillSensorsIn(std::string &title, std::vector<double> & data);
+    /// \brief Fill the SoT map structures through a precomputed binding.
+    void fillSensorsIn(SensorBinding &binding);
+
+    /// \brief Resolve the slot of the SoT map structures associated to title.
+    SensorBinding bindSensorsIn(const std::string &title,
+				std::vector<double> &data);
+
+    /// \brief Resolve the bindings of all the ros-control quantities.
+    void initSensorsInBindings();
 
     /// \brief Get the information from the low level and calls fillSensorsIn.
     void fillJoints();
     
-    /// In the map sensorsIn_ creates the key "name_IMUNb"
-    /// and associate to this key the vector data.
-    void setSensorsImu(std::string &name,
-		       int IMUNb,
-		       std::vector<double> &data);
+    /// Resolve the binding of the key "name_IMUNb" in the map sensorsIn_
+    /// to the vector data.
+    SensorBinding bindSensorsImu(const std::string &name,
+				 int IMUNb,
+				 std::vector<double> &data);
 
     /// @{ \name Fill the sensors 
     /// Read the imus and set the interface to the SoT.
@@ -287,11 +413,28 @@ namespace sot_controller
     
     ///@}
     /// Extract control values to send to the simulator.
-    void readControl(std::map<std::string,dgs::ControlValues> &controlValues);
+    void readControl();
+
+    /// \brief Resolve the entry of the control values sent to the joints.
+    void initControlBinding();
 
     /// Map of sensor readings
     std::map <std::string,dgs::SensorValues> sensorsIn_;
 
+    /// \brief Bindings of the joint quantities to the SoT sensors:
+    /// motor-angles, joint-angles, velocities, torques and currents.
+    std::vector<SensorBinding> joints_sensors_bindings_;
+
+    /// \brief Bindings of the IMUs to the SoT sensors:
+    /// orientation, gyrometer and accelerometer for each IMU.
+    std::vector<SensorBinding> imu_sensors_bindings_;
+
+    /// \brief Binding of the force sensors to the SoT sensors.
+    SensorBinding force_sensors_binding_;
+
+    /// \brief Binding of the actuator temperatures to the SoT sensors.
+    SensorBinding temp_sensors_binding_;
+
     /// Map of control values
     std::map<std::string,dgs::ControlValues> controlValues_;
 
@@ -301,13 +444,40 @@ namespace sot_controller
     /// \brief Command send to motors
     /// Depending on control_mode it can be either
     /// position control or torque control.
-    std::vector<double> command_;
+    /// It points to the entry of controlValues_ filled by the SoT device,
+    /// NULL if the command is not mapped.
+    const dgs::ControlValues * command_;
     
     /// One iteration: read sensor, compute the control law, apply control.
     void one_iteration();
 
+    /// One iteration in pipelined mode: read sensor, give them to the
+    /// worker and apply the control computed at the previous iteration.
+    void one_iteration_pipelined();
+
+    /// \brief Lock the memory and touch the log buffers.
+    void initRealTime();
+
+    /// \brief Create the worker evaluating the SoT and its buffers.
+    void initPipeline();
+    /// \brief Prepare the worker for a new start, without allocating.
+    void resetPipeline();
+    /// \brief Stop the worker and wait for it (not real-time).
+    void stopPipeline();
+    /// \brief Release the SoT and the real-time logger.
+    void cleanupSot();
+
+    /// \brief Body of the worker evaluating the SoT.
+    void pipelineThread();
+
     /// Read URDF model from /robot_description parameter.
     bool readUrdf(ros::NodeHandle &robot_nh);
+
+    /// \brief Create the latency publisher and start its thread.
+    void initLatencyPublisher(ros::NodeHandle &controller_nh);
+
+    /// \brief Body of the thread publishing the latencies.
+    void latencyThread();
   };
 }
 
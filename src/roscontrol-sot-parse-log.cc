@@ -1,44 +1,944 @@
-#include <fstream>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <iomanip>
+#include <istream>
+#include <list>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
 
-int main (int argc, char* argv[])
+#include "log-format.hh"
+#include "log-codec.hh"
+#include "log-text.hh"
+
+using namespace rc_sot_system;
+
+// The text is formatted in a buffer of this size which is written at once.
+static const std::size_t OUTPUT_BUFFER_SIZE = 1<<22;
+
+// Input file mapped in memory.
+class MappedFile
 {
-  if (argc != 2) {
-    std::cerr << "Usage: " << argv[0] << " binary_file_name\n";
-    return 1;
+public:
+  MappedFile () : data_ (NULL), size_ (0) {}
+  ~MappedFile () { close(); }
+
+  bool open (const char* filename)
+  {
+    int fd = ::open (filename, O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    bool ok = fstat (fd, &st) == 0;
+    if (ok && st.st_size > 0) {
+      void* data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED)
+        ok = false;
+      else {
+        data_ = (const char*)data;
+        size_ = st.st_size;
+        // The whole file is read: start the read-ahead now.
+        madvise (data, size_, MADV_WILLNEED);
+      }
+    }
+    ::close (fd);
+    return ok;
   }
 
-  std::ifstream in (argv[1], std::ios::binary);
-  if (!in.is_open() || !in.good()) {
-    std::cerr << "Couldn't open file " << argv[1] << '\n';
-    return 2;
+  void close ()
+  {
+    if (data_ != NULL)
+      munmap ((void*)data_, size_);
+    data_ = NULL;
+    size_ = 0;
+  }
+
+  const char* data () const { return data_; }
+  std::size_t size () const { return size_; }
+
+private:
+  const char* data_;
+  std::size_t size_;
+};
+
+// Read the header of the container with the functions of log-format.hh
+// directly from the mapping.
+class MemoryBuffer : public std::streambuf
+{
+public:
+  MemoryBuffer (const char* data, std::size_t size)
+  {
+    char* begin = const_cast<char*> (data);
+    setg (begin, begin, begin + size);
+  }
+};
+
+// CRC-32 of the zip format (polynomial 0xedb88320), updated with n bytes.
+static uint32_t crc32Update (uint32_t crc, const char* data, std::size_t n)
+{
+  static uint32_t table[256];
+  if (table[1] == 0)
+    for (uint32_t b=0; b < 256; ++b) {
+      uint32_t c = b;
+      for (int k=0; k < 8; ++k)
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      table[b] = c;
+    }
+  crc = ~crc;
+  for (std::size_t i=0; i < n; ++i)
+    crc = table[(crc ^ (unsigned char)data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+// Buffered output on a file descriptor, as text or raw bytes.
+// The CRC-32 of the bytes written can be computed on the way.
+class BufferedOutput
+{
+public:
+  BufferedOutput (int fd)
+    : fd_ (fd), buffer_ (OUTPUT_BUFFER_SIZE), size_ (0), written_ (0),
+      failed_ (false), withCrc_ (false), crc_ (0) {}
+  ~BufferedOutput () { flush(); }
+
+  void put (char c)
+  {
+    if (size_ + 1 > buffer_.size())
+      flush();
+    buffer_[size_++] = c;
   }
 
-  // Read headers
+  void put (const std::string& str)
+  {
+    for (std::size_t i = 0; i < str.size(); ++i)
+      put (str[i]);
+  }
+
+  void put (double v)
+  {
+    if (size_ + MAX_DOUBLE_TEXT > buffer_.size())
+      flush();
+    size_ += formatDouble (v, &buffer_[size_]);
+  }
+
+  // Raw bytes. A block larger than the buffer is written directly.
+  void append (const void* data, std::size_t n)
+  {
+    if (size_ + n > buffer_.size()) {
+      flush();
+      if (n > buffer_.size()) {
+        writeAll ((const char*)data, n);
+        return;
+      }
+    }
+    memcpy (&buffer_[size_], data, n);
+    size_ += n;
+  }
+
+  bool flush ()
+  {
+    writeAll (&buffer_[0], size_);
+    size_ = 0;
+    return !failed_;
+  }
+
+  // Start the CRC of the next bytes, after the buffered ones.
+  void startCrc ()
+  {
+    flush();
+    withCrc_ = true;
+    crc_ = 0;
+  }
+
+  // Stop the CRC and return it.
+  uint32_t stopCrc ()
+  {
+    flush();
+    withCrc_ = false;
+    return crc_;
+  }
+
+  // Bytes written so far, buffered ones included.
+  uint64_t position () const { return written_ + size_; }
+  uint64_t written () const { return written_; }
+
+private:
+  void writeAll (const char* data, std::size_t size)
+  {
+    if (withCrc_)
+      crc_ = crc32Update (crc_, data, size);
+    while (size > 0 && !failed_) {
+      ssize_t n = ::write (fd_, data, size);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0) {
+        failed_ = true;
+        break;
+      }
+      data += n;
+      size -= n;
+      written_ += n;
+    }
+  }
+
+  int fd_;
+  std::vector<char> buffer_;
+  std::size_t size_;
+  uint64_t written_;
+  bool failed_;
+  bool withCrc_;
+  uint32_t crc_;
+};
+
+// Values of a column: data[i*stride] for the sample i.
+// A compressed column has no data until it is decoded.
+struct LogColumn
+{
+  std::string name;
+  const double* data;
+  std::size_t stride;
+  const unsigned char* encoded;
+  std::size_t encodedSize;
+
+  LogColumn () : data (NULL), stride (1), encoded (NULL), encodedSize (0) {}
+  double value (std::size_t i) const { return data[i*stride]; }
+};
+
+// Columns of a log sharing the same samples.
+// The first column is the time.
+struct LogTable
+{
+  std::size_t nbRows;
+  std::vector<LogColumn> columns;
+  // Storage of the decompressed columns.
+  std::list< std::vector<double> > decoded;
+
+  LogTable () : nbRows (0) {}
+
+  // Decompress the column j if needed.
+  void decode (std::size_t j)
+  {
+    LogColumn& column = columns[j];
+    if (column.data != NULL)
+      return;
+    decoded.push_back (std::vector<double> (nbRows + 1));
+    std::vector<double>& values = decoded.back();
+    decodeLogColumn (column.encoded, column.encodedSize, nbRows, &values[0]);
+    column.data = &values[0];
+  }
+};
+
+// Describe the columns of a single-file columnar log.
+static int loadContainer (const MappedFile& file, const char* filename,
+    LogTable& table)
+{
+  MemoryBuffer buffer (file.data(), file.size());
+  std::istream in (&buffer);
+  LogHeader header;
+  if (!readLogHeader (in, header)) {
+    std::cerr << "Couldn't parse file: " << filename << '\n';
+    return 3;
+  }
+
+  if (header.nbDropped > 0)
+    std::cerr << filename << ": " << header.nbDropped
+      << " samples were dropped while the log was saved\n";
+  table.nbRows = header.nbSamples;
+  const uint64_t columnSize = header.nbSamples*sizeof(double);
+  for (std::size_t i=0; i < header.channels.size(); ++i) {
+    const LogChannelHeader& channel = header.channels[i];
+    for (std::size_t j=0; j < channel.columns.size(); ++j) {
+      LogColumn column;
+      column.name = channel.name + '/' + channel.columns[j];
+      bool ok;
+      if (channel.type == LOG_TYPE_DOUBLE_XOR) {
+        // Position and size of the compressed column.
+        uint64_t entry[2] = { 0, 0 };
+        uint64_t pos = channel.offset + j*sizeof(entry);
+        ok = pos + sizeof(entry) <= file.size();
+        if (ok) {
+          memcpy (entry, file.data() + pos, sizeof(entry));
+          ok = entry[0] + entry[1] <= file.size();
+        }
+        if (ok) {
+          // Only the selected columns are decoded.
+          column.encoded = (const unsigned char*)file.data() + entry[0];
+          column.encodedSize = entry[1];
+        }
+      } else {
+        uint64_t pos = channel.offset + j*channel.stride;
+        ok = pos + columnSize <= file.size() && pos % sizeof(double) == 0;
+        if (ok)
+          column.data = (const double*)(file.data() + pos);
+      }
+      if (!ok) {
+        std::cerr << "Stopped to parse column " << channel.name << '/'
+          << channel.columns[j] << " of file: " << filename << '\n';
+        return 4;
+      }
+      table.columns.push_back (column);
+    }
+  }
+  return 0;
+}
+
+// Describe the columns of a file of rows written by Log::save or
+// streamed. A truncated file gives the complete rows and the error 4.
+// A stream whose writer died may hold more rows than its header:
+// they are all read.
+static int loadRows (const MappedFile& file, const char* filename,
+    LogTable& table)
+{
   unsigned int nVector = 0, vectorSize = 0;
-  in.read ((char*)&nVector   , sizeof(unsigned int));
-  in.read ((char*)&vectorSize, sizeof(unsigned int));
-  if (!in.good()) {
-    std::cerr << "Couldn't parse file: " << argv[1] << '\n';
+  const std::size_t headerSize = 2*sizeof(unsigned int);
+  if (file.size() < headerSize) {
+    std::cerr << "Couldn't parse file: " << filename << '\n';
     return 3;
   }
+  memcpy (&nVector, file.data(), sizeof(unsigned int));
+  memcpy (&vectorSize, file.data() + sizeof(unsigned int), sizeof(unsigned int));
 
-  // Read datas
-  double v;
-  std::cout << std::setprecision(12) << std::setw(12) << std::setfill('0');
+  const double* rows = (const double*)(file.data() + headerSize);
+  const std::size_t nbValues = (file.size() - headerSize) / sizeof(double);
+  table.nbRows = nVector;
+  if (vectorSize > 0 && nbValues / vectorSize != nVector) {
+    table.nbRows = nbValues / vectorSize;
+    if (table.nbRows > nVector)
+      std::cerr << "The header of " << filename << " has " << nVector
+        << " rows, reading the " << table.nbRows << " of the file\n";
+  }
+  for (std::size_t j=0; j < vectorSize; ++j) {
+    LogColumn column;
+    column.data = rows + j;
+    column.stride = vectorSize;
+    table.columns.push_back (column);
+  }
 
-  for (std::size_t i=0; i < nVector; ++i) {
-    for (std::size_t j=0; j < vectorSize; ++j) {
-      in.read ((char*)&v, sizeof(double));
-      if (!in.good()) {
-        std::cerr << "Stopped to parse at (" << i << ',' << j
-          << ") of file: " << argv[1] << '\n';
-        return 4;
+  return table.nbRows < nVector ? 4 : 0;
+}
+
+// Channels written by Log::save, in the order of the container.
+static const char* const CHANNEL_FILES[][2] = {
+  { "-mastate.log", "motor_angle" },
+  { "-jastate.log", "joint_angle" },
+  { "-vstate.log", "velocities" },
+  { "-torques.log", "torques" },
+  { "-motor-currents.log", "motor_currents" },
+  { "-accelero.log", "accelerometer" },
+  { "-gyro.log", "gyrometer" },
+  { "-forceSensors.log", "force_sensors" },
+  { "-temperatures.log", "temperatures" },
+  { "-duration.log", "duration" },
+  { "-rostime.log", "ros_time" },
+  { "-phases.log", "phases" } };
+static const std::size_t NB_CHANNEL_FILES =
+  sizeof(CHANNEL_FILES)/sizeof(CHANNEL_FILES[0]);
+
+// Gather the files prefix-*.log of a run in one table.
+// The files share the time base: t and dt are taken from the first one,
+// and the other columns are named channel/index.
+static int loadRun (const std::string& prefix, std::list<MappedFile>& files,
+    LogTable& table)
+{
+  glob_t found;
+  std::string pattern = prefix + "-*.log";
+  if (glob (pattern.c_str(), 0, NULL, &found) != 0) {
+    std::cerr << "Couldn't open file " << prefix
+      << " nor the files " << pattern << '\n';
+    return 2;
+  }
+
+  // Known channels first, then the others in alphabetical order.
+  std::vector<std::string> paths, names;
+  std::vector<bool> used (found.gl_pathc, false);
+  for (std::size_t c=0; c <= NB_CHANNEL_FILES; ++c)
+    for (std::size_t i=0; i < found.gl_pathc; ++i) {
+      std::string path (found.gl_pathv[i]);
+      std::string suffix = path.substr (prefix.size());
+      if (used[i] || (c < NB_CHANNEL_FILES && suffix != CHANNEL_FILES[c][0]))
+        continue;
+      used[i] = true;
+      paths.push_back (path);
+      names.push_back (c < NB_CHANNEL_FILES ? std::string (CHANNEL_FILES[c][1])
+          : suffix.substr (1, suffix.size() - 5));
+    }
+  globfree (&found);
+
+  for (std::size_t f=0; f < paths.size(); ++f) {
+    files.resize (files.size() + 1);
+    MappedFile& file = files.back();
+    LogTable channel;
+    if (!file.open (paths[f].c_str())) {
+      std::cerr << "Couldn't open file " << paths[f] << '\n';
+      return 2;
+    }
+    int status = loadRows (file, paths[f].c_str(), channel);
+    if (status == 3)
+      return status;
+    if (status == 4)
+      std::cerr << "Only the " << channel.nbRows
+        << " complete rows of the truncated file " << paths[f]
+        << " are used\n";
+    if (channel.columns.size() < 2) {
+      std::cerr << "No time in file: " << paths[f] << '\n';
+      return 3;
+    }
+
+    if (f == 0) {
+      table.nbRows = channel.nbRows;
+      channel.columns[0].name = "time/t";
+      channel.columns[1].name = "time/dt";
+      table.columns.push_back (channel.columns[0]);
+      table.columns.push_back (channel.columns[1]);
+    } else {
+      std::size_t nbRows = std::min (table.nbRows, channel.nbRows);
+      if (nbRows > 0 && (channel.columns[0].value (0)
+            != table.columns[0].value (0)
+            || channel.columns[0].value (nbRows-1)
+            != table.columns[0].value (nbRows-1)))
+        std::cerr << "The time of " << paths[f]
+          << " differs from the one of " << paths[0] << '\n';
+      if (channel.nbRows != table.nbRows)
+        std::cerr << "The files of the run have different lengths: "
+          << "only the first " << nbRows << " rows are written\n";
+      table.nbRows = nbRows;
+    }
+    for (std::size_t j=2; j < channel.columns.size(); ++j) {
+      std::ostringstream name;
+      name << names[f] << '/' << j-2;
+      channel.columns[j].name = name.str();
+      table.columns.push_back (channel.columns[j]);
+    }
+  }
+  return 0;
+}
+
+// Rows and columns to write.
+struct LogSelection
+{
+  bool hasFrom, hasTo;
+  double from, to;
+  // Comma separated indices, index ranges (a-b) and names.
+  std::string columns;
+
+  LogSelection () : hasFrom (false), hasTo (false), from (0), to (0) {}
+};
+
+// Select the columns matching one item of the list: an index, a range of
+// indices, the name of a column or the last part of it (a joint name
+// selects this joint in all the channels).
+static bool selectColumns (const LogTable& table, const std::string& list,
+    std::vector<std::size_t>& selected)
+{
+  std::size_t begin = 0;
+  while (begin <= list.size()) {
+    std::size_t end = list.find (',', begin);
+    if (end == std::string::npos)
+      end = list.size();
+    std::string item = list.substr (begin, end - begin);
+    begin = end + 1;
+    if (item.empty())
+      continue;
+
+    char* stop;
+    unsigned long first = strtoul (item.c_str(), &stop, 10), last = first;
+    bool index = stop != item.c_str() && isdigit (item[0]);
+    if (index && *stop == '-')
+      last = strtoul (stop + 1, &stop, 10);
+    if (index && *stop == '\0') {
+      if (last < first || last >= table.columns.size()) {
+        std::cerr << "No column " << item << ": there are "
+          << table.columns.size() << " columns\n";
+        return false;
+      }
+      for (unsigned long j=first; j <= last; ++j)
+        selected.push_back (j);
+      continue;
+    }
+
+    bool found = false;
+    for (std::size_t j=0; j < table.columns.size(); ++j) {
+      const std::string& name = table.columns[j].name;
+      std::size_t slash = name.rfind ('/');
+      if (name == item || (slash != std::string::npos
+            && name.compare (slash + 1, std::string::npos, item) == 0)) {
+        selected.push_back (j);
+        found = true;
       }
-      std::cout << v << ' ';
     }
-    std::cout << '\n';
+    if (!found) {
+      std::cerr << "No column named " << item;
+      if (table.columns.empty() || table.columns[0].name.empty())
+        std::cerr << ": the columns of this file have no names, use indices";
+      std::cerr << '\n';
+      return false;
+    }
+  }
+  return true;
+}
+
+// First row at or after t, by binary search on the time column.
+static std::size_t lowerRow (const LogTable& table, double t)
+{
+  std::size_t first = 0, count = table.nbRows;
+  while (count > 0) {
+    std::size_t step = count / 2;
+    if (table.columns[0].value (first + step) < t) {
+      first += step + 1;
+      count -= step + 1;
+    } else
+      count = step;
+  }
+  return first;
+}
+
+// First row after t.
+static std::size_t upperRow (const LogTable& table, double t)
+{
+  std::size_t first = 0, count = table.nbRows;
+  while (count > 0) {
+    std::size_t step = count / 2;
+    if (!(t < table.columns[0].value (first + step))) {
+      first += step + 1;
+      count -= step + 1;
+    } else
+      count = step;
+  }
+  return first;
+}
+
+// Write the rows [first,last) of the columns as text:
+// one row per sample, one column per value.
+static void writeTable (const LogTable& table,
+    const std::vector<std::size_t>& columns,
+    std::size_t first, std::size_t last, bool names, BufferedOutput& out)
+{
+  if (names) {
+    out.put ('#');
+    for (std::size_t j=0; j < columns.size(); ++j) {
+      out.put (' ');
+      out.put (table.columns[columns[j]].name);
+    }
+    out.put ('\n');
+  }
+  std::vector<const LogColumn*> selected;
+  for (std::size_t j=0; j < columns.size(); ++j)
+    selected.push_back (&table.columns[columns[j]]);
+  for (std::size_t i=first; i < last; ++i) {
+    for (std::size_t j=0; j < selected.size(); ++j) {
+      out.put (selected[j]->value (i));
+      out.put (' ');
+    }
+    out.put ('\n');
+  }
+}
+
+// Header of a .npy file (format 1.0) of a C-ordered array of the given
+// dtype and shape: one dimension when cols is 0. It is padded so that
+// the data start on a 64 bytes boundary.
+static std::string npyHeader (const std::string& descr, std::size_t rows,
+    std::size_t cols)
+{
+  std::ostringstream dict;
+  dict << "{'descr': '" << descr << "', 'fortran_order': False, 'shape': ("
+    << rows;
+  if (cols > 0)
+    dict << ", " << cols;
+  else
+    dict << ',';
+  dict << "), }";
+  std::string header = dict.str();
+  header.append (63 - (10 + header.size()) % 64, ' ');
+  header += '\n';
+  std::string npy ("\x93NUMPY\x01\x00", 8);
+  npy += (char)(header.size() & 0xff);
+  npy += (char)(header.size() >> 8);
+  return npy + header;
+}
+
+// Size of the .npy file written by writeNpy.
+static uint64_t npySize (std::size_t nbColumns, std::size_t first,
+    std::size_t last)
+{
+  return npyHeader ("<f8", last - first, nbColumns).size()
+    + (uint64_t)sizeof(double)*(last - first)*nbColumns;
+}
+
+// Write the rows [first,last) of the columns as a 2-D array of doubles.
+// The rows of a file of rows are already laid out this way: they are
+// written from the mapping when all of their values are selected, and
+// copied one row at a time when the selection is a contiguous slice.
+static void writeNpy (const LogTable& table,
+    const std::vector<std::size_t>& columns,
+    std::size_t first, std::size_t last, BufferedOutput& out)
+{
+  out.put (npyHeader ("<f8", last - first, columns.size()));
+  if (columns.empty() || first >= last)
+    return;
+  std::vector<const LogColumn*> selected;
+  bool contiguous = true;
+  for (std::size_t j=0; j < columns.size(); ++j) {
+    selected.push_back (&table.columns[columns[j]]);
+    contiguous = contiguous && selected[j]->stride == selected[0]->stride
+      && selected[j]->data == selected[0]->data + j;
+  }
+  const double* data = selected[0]->data;
+  std::size_t stride = selected[0]->stride;
+  std::size_t rowSize = sizeof(double)*selected.size();
+  if (contiguous && stride == selected.size())
+    out.append (data + first*stride, rowSize*(last - first));
+  else if (contiguous)
+    for (std::size_t i=first; i < last; ++i)
+      out.append (data + i*stride, rowSize);
+  else {
+    std::vector<double> row (selected.size());
+    for (std::size_t i=first; i < last; ++i) {
+      for (std::size_t j=0; j < selected.size(); ++j)
+        row[j] = selected[j]->value (i);
+      out.append (&row[0], rowSize);
+    }
+  }
+}
+
+// Longest name of the columns, in characters.
+static std::size_t nameLength (const LogTable& table,
+    const std::vector<std::size_t>& columns)
+{
+  std::size_t length = 1;
+  for (std::size_t j=0; j < columns.size(); ++j)
+    length = std::max (length, table.columns[columns[j]].name.size());
+  return length;
+}
+
+// Header of the array of the names of the columns.
+static std::string npyNamesHeader (const LogTable& table,
+    const std::vector<std::size_t>& columns)
+{
+  std::ostringstream descr;
+  descr << "<U" << nameLength (table, columns);
+  return npyHeader (descr.str(), columns.size(), 0);
+}
+
+// Write the names of the columns as a 1-D array of unicode strings.
+static void writeNpyNames (const LogTable& table,
+    const std::vector<std::size_t>& columns, BufferedOutput& out)
+{
+  std::size_t length = nameLength (table, columns);
+  out.put (npyNamesHeader (table, columns));
+  // UTF-32: the names are ASCII.
+  std::vector<char> name (4*length);
+  for (std::size_t j=0; j < columns.size(); ++j) {
+    const std::string& str = table.columns[columns[j]].name;
+    std::fill (name.begin(), name.end(), 0);
+    for (std::size_t k=0; k < str.size(); ++k)
+      name[4*k] = str[k];
+    out.append (&name[0], name.size());
+  }
+}
+
+static void putLE (std::string& str, uint64_t v, int bytes)
+{
+  for (int k=0; k < bytes; ++k)
+    str += (char)((v >> (8*k)) & 0xff);
+}
+
+// Entry of a zip archive without compression.
+struct ZipEntry
+{
+  std::string name;
+  uint64_t offset, size;
+  uint32_t crc;
+};
+
+// Zip records with the fields after the signature up to the file name.
+// The entries are stored (method 0) and dated 1980-01-01.
+static std::string zipRecord (uint32_t signature, const ZipEntry& entry,
+    bool central)
+{
+  std::string record;
+  putLE (record, signature, 4);
+  if (central)
+    putLE (record, 20, 2);      // version made by
+  putLE (record, 20, 2);        // version needed to extract
+  putLE (record, 0, 2);         // flags
+  putLE (record, 0, 2);         // method
+  putLE (record, 0, 2);         // time
+  putLE (record, 0x21, 2);      // date
+  putLE (record, entry.crc, 4);
+  putLE (record, entry.size, 4);
+  putLE (record, entry.size, 4);
+  putLE (record, entry.name.size(), 2);
+  putLE (record, 0, 2);         // extra field
+  if (central) {
+    putLE (record, 0, 2);       // comment
+    putLE (record, 0, 2);       // disk
+    putLE (record, 0, 2);       // internal attributes
+    putLE (record, 0, 4);       // external attributes
+    putLE (record, entry.offset, 4);
+  }
+  return record + entry.name;
+}
+
+// Write the columns as a .npz archive, the format of numpy.savez: one
+// 2-D array per channel (the part of the name before '/', "data" for
+// the columns of a file of rows) and the names of the columns in
+// "columns". The CRC of an entry is known once it is written: it is
+// written in its local header afterwards.
+static int writeNpz (const char* filename, const LogTable& table,
+    const std::vector<std::size_t>& columns,
+    std::size_t first, std::size_t last, uint64_t& written)
+{
+  std::vector<std::string> channels;
+  std::vector< std::vector<std::size_t> > groups;
+  for (std::size_t j=0; j < columns.size(); ++j) {
+    const std::string& name = table.columns[columns[j]].name;
+    std::string channel = name.substr (0, name.find ('/'));
+    if (channel.empty())
+      channel = "data";
+    std::size_t g = std::find (channels.begin(), channels.end(), channel)
+      - channels.begin();
+    if (g == channels.size()) {
+      channels.push_back (channel);
+      groups.push_back (std::vector<std::size_t>());
+    }
+    groups[g].push_back (columns[j]);
+  }
+  bool names = !columns.empty() && !table.columns[columns[0]].name.empty();
+
+  // Without the zip64 extensions, offsets and sizes are 32 bits:
+  // check the offset of the central directory, with a margin for the
+  // array of the names.
+  uint64_t total = 30*(groups.size() + 1);
+  for (std::size_t g=0; g < groups.size(); ++g)
+    total += npySize (groups[g].size(), first, last) + channels[g].size();
+  if (total > 0xffffffffu - (1u << 20)) {
+    std::cerr << "The arrays are too large for a .npz file: select fewer "
+      "columns or a shorter time range.\n";
+    return 5;
+  }
+
+  int fd = ::open (filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    std::cerr << "Couldn't open file " << filename << '\n';
+    return 2;
+  }
+  std::vector<ZipEntry> entries;
+  bool ok = true;
+  {
+    BufferedOutput out (fd);
+    for (std::size_t g=0; g <= groups.size() && ok; ++g) {
+      if (g == groups.size() && !names)
+        break;
+      ZipEntry entry;
+      entry.offset = out.position();
+      entry.crc = 0;
+      if (g < groups.size()) {
+        entry.name = channels[g] + ".npy";
+        entry.size = npySize (groups[g].size(), first, last);
+      } else {
+        entry.name = "columns.npy";
+        entry.size = npyNamesHeader (table, columns).size()
+          + 4*nameLength (table, columns)*columns.size();
+      }
+      out.put (zipRecord (0x04034b50, entry, false));
+      out.startCrc();
+      if (g < groups.size())
+        writeNpy (table, groups[g], first, last, out);
+      else
+        writeNpyNames (table, columns, out);
+      entry.crc = out.stopCrc();
+      std::string crc;
+      putLE (crc, entry.crc, 4);
+      ok = out.flush()
+        && pwrite (fd, crc.data(), 4, entry.offset + 14) == 4;
+      entries.push_back (entry);
+    }
+
+    uint64_t directory = out.position();
+    for (std::size_t e=0; e < entries.size(); ++e)
+      out.put (zipRecord (0x02014b50, entries[e], true));
+    std::string end;
+    putLE (end, 0x06054b50, 4);
+    putLE (end, 0, 2);          // disk
+    putLE (end, 0, 2);          // disk of the central directory
+    putLE (end, entries.size(), 2);
+    putLE (end, entries.size(), 2);
+    putLE (end, out.position() - directory, 4);
+    putLE (end, directory, 4);
+    putLE (end, 0, 2);          // comment
+    out.put (end);
+    ok = out.flush() && ok;
+    written = out.written();
+  }
+  if (::close (fd) != 0 || !ok) {
+    std::cerr << "Couldn't write file " << filename << ": "
+      << strerror (errno) << '\n';
+    return 5;
+  }
+  return 0;
+}
+
+static double now ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+static void usage (const char* name)
+{
+  std::cerr << "Usage: " << name << " [options] binary_file_name|prefix\n"
+    << "With the prefix of a run (/tmp/sot.log), the files prefix-*.log\n"
+    << "are written side by side with a single time base.\n"
+    << "  --from t       first time written (s)\n"
+    << "  --to t         last time written (s)\n"
+    << "  --columns list columns written, in this order: indices (0 is\n"
+    << "                 the time), ranges (2-5), names or joint names\n"
+    << "  --npy file     write a NumPy array of the values instead of text\n"
+    << "  --npz file     write a NumPy archive instead of text: one array per\n"
+    << "                 channel and the names of the columns in 'columns'\n"
+    << "  --stats        print the conversion throughput on stderr\n"
+    << "The time range is found by binary search: the time has to be\n"
+    << "increasing, as in the files written by the controller.\n";
+}
+
+int main (int argc, char* argv[])
+{
+  bool stats = false;
+  const char* filename = NULL;
+  const char* npyFile = NULL;
+  const char* npzFile = NULL;
+  LogSelection selection;
+  for (int i=1; i < argc; ++i) {
+    std::string arg (argv[i]);
+    bool hasValue = i + 1 < argc;
+    if (arg == "--stats")
+      stats = true;
+    else if (arg == "--from" && hasValue) {
+      selection.hasFrom = true;
+      selection.from = strtod (argv[++i], NULL);
+    } else if (arg == "--to" && hasValue) {
+      selection.hasTo = true;
+      selection.to = strtod (argv[++i], NULL);
+    } else if (arg == "--columns" && hasValue)
+      selection.columns = argv[++i];
+    else if (arg == "--npy" && hasValue)
+      npyFile = argv[++i];
+    else if (arg == "--npz" && hasValue)
+      npzFile = argv[++i];
+    else if (filename == NULL && arg.compare (0, 2, "--") != 0)
+      filename = argv[i];
+    else {
+      usage (argv[0]);
+      return 1;
+    }
+  }
+  if (filename == NULL || (npyFile != NULL && npzFile != NULL)) {
+    usage (argv[0]);
+    return 1;
+  }
+
+  double start = now();
+  std::list<MappedFile> files (1);
+  MappedFile& file = files.front();
+  LogTable table;
+  bool container = false, names = true;
+  int status;
+  if (!file.open (filename)) {
+    // Not a file: the prefix of the files of a run.
+    if (errno != ENOENT) {
+      std::cerr << "Couldn't open file " << filename << '\n';
+      return 2;
+    }
+    status = loadRun (filename, files, table);
+    if (status != 0)
+      return status;
+  } else {
+    container = file.size() >= sizeof(LOG_MAGIC)
+      && memcmp (file.data(), LOG_MAGIC, sizeof(LOG_MAGIC)) == 0;
+    status = container ? loadContainer (file, filename, table)
+      : loadRows (file, filename, table);
+    names = container;
+    // A truncated file of rows still gives its complete rows.
+    if (status != 0 && (container || status != 4))
+      return status;
+  }
+
+  std::vector<std::size_t> columns;
+  if (selection.columns.empty())
+    for (std::size_t j=0; j < table.columns.size(); ++j)
+      columns.push_back (j);
+  else if (!selectColumns (table, selection.columns, columns))
+    return 1;
+
+  std::size_t first = 0, last = table.nbRows;
+  if ((selection.hasFrom || selection.hasTo) && !table.columns.empty()) {
+    table.decode (0);
+    if (selection.hasFrom)
+      first = lowerRow (table, selection.from);
+    if (selection.hasTo)
+      last = std::max (first, upperRow (table, selection.to));
+  }
+  for (std::size_t j=0; j < columns.size(); ++j)
+    table.decode (columns[j]);
+
+  uint64_t written = 0;
+  if (npzFile != NULL) {
+    int error = writeNpz (npzFile, table, columns, first, last, written);
+    if (error != 0)
+      return error;
+  } else {
+    int fd = STDOUT_FILENO;
+    if (npyFile != NULL
+        && (fd = ::open (npyFile, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+      std::cerr << "Couldn't open file " << npyFile << '\n';
+      return 2;
+    }
+    BufferedOutput out (fd);
+    if (npyFile != NULL)
+      writeNpy (table, columns, first, last, out);
+    else
+      writeTable (table, columns, first, last, names, out);
+    bool ok = out.flush();
+    written = out.written();
+    if (npyFile != NULL)
+      ok = ::close (fd) == 0 && ok;
+    if (!ok) {
+      std::cerr << "Couldn't write "
+        << (npyFile != NULL ? npyFile : "the output") << ": "
+        << strerror (errno) << '\n';
+      return 5;
+    }
+  }
+
+  if (status == 4) {
+    std::cerr << "Stopped to parse at (" << table.nbRows << ','
+      << (file.size() - 2*sizeof(unsigned int)) / sizeof(double)
+         - table.nbRows*table.columns.size()
+      << ") of file: " << filename << '\n';
+    return status;
+  }
+
+  if (stats) {
+    double elapsed = now() - start;
+    double mb = 1e-6*sizeof(double)*(double)(last - first)*columns.size();
+    std::cerr << "Converted " << mb << " MB of values into "
+      << 1e-6*(double)written << " MB of "
+      << (npyFile != NULL || npzFile != NULL ? "NumPy arrays" : "text")
+      << " in " << elapsed
+      << " s: " << mb/elapsed << " MB/s\n";
   }
   return 0;
 }
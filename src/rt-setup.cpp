@@ -0,0 +1,137 @@
+/*
+   Preparation of the process and of the threads for real-time execution.
+*/
+#include "rt-setup.hh"
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <alloca.h>
+#include <cerrno>
+#include <cstring>
+
+#include <ros/console.h>
+
+namespace sot_controller
+{
+  RealTimeSetup::RealTimeSetup():
+    lock_memory(false),
+    prefault_log(false),
+    prefault_stack(0),
+    worker_cpu(-1),
+    worker_priority(0)
+  {
+  }
+
+  bool lockMemory()
+  {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)!=0)
+      {
+	ROS_WARN_STREAM("RT setup: mlockall failed: " << strerror(errno));
+	return false;
+      }
+    ROS_INFO_STREAM("RT setup: memory locked");
+    return true;
+  }
+
+  /// Stack kept free below the touched pages for the calls made after,
+  /// in bytes.
+  static const std::size_t STACK_MARGIN = 65536;
+
+  // Bytes between the frame of the caller and the end of the stack of
+  // the calling thread, or the stack limit of the process if unknown.
+  // 0 if neither is known.
+  static std::size_t __attribute__((noinline)) stackAvailable()
+  {
+    std::size_t available = 0;
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(),&attr)==0)
+      {
+	void *addr;
+	std::size_t size;
+	char here;
+	// The stack grows down to addr.
+	if (pthread_attr_getstack(&attr,&addr,&size)==0 &&
+	    &here>(char*)addr && &here<=(char*)addr+size)
+	  available = (std::size_t)(&here-(char*)addr);
+	pthread_attr_destroy(&attr);
+      }
+    struct rlimit limit;
+    if (available==0 && getrlimit(RLIMIT_STACK,&limit)==0 &&
+	limit.rlim_cur!=RLIM_INFINITY)
+      available = (std::size_t)limit.rlim_cur;
+    return available;
+  }
+
+  bool __attribute__((noinline)) prefaultStack(std::size_t size)
+  {
+    std::size_t available = stackAvailable();
+    if (available<=STACK_MARGIN)
+      {
+	ROS_WARN_STREAM("RT setup: size of the stack unknown,"
+			" the stack is not touched");
+	return false;
+      }
+    bool clamped = size>available-STACK_MARGIN;
+    if (clamped)
+      {
+	ROS_WARN_STREAM("RT setup: " << size << " bytes of stack requested, "
+			<< available << " available: only "
+			<< available-STACK_MARGIN << " bytes touched");
+	size = available-STACK_MARGIN;
+      }
+
+    // The pages stay mapped once the function returns.
+    const std::size_t page = (std::size_t)sysconf(_SC_PAGESIZE);
+    volatile char *stack = (volatile char*)alloca(size);
+    for(std::size_t i=0;i<size;i+=page)
+      stack[i] = 0;
+    ROS_INFO_STREAM("RT setup: " << size << " bytes of stack touched");
+    return !clamped;
+  }
+
+  bool setThreadAffinity(pthread_t thread, int cpu,
+			 const std::string &name)
+  {
+    long nbCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu<0 || cpu>=CPU_SETSIZE || (nbCpus>0 && cpu>=nbCpus))
+      {
+	ROS_WARN_STREAM("RT setup: could not pin the " << name
+			<< " thread on CPU " << cpu << ": "
+			<< nbCpus << " CPUs online");
+	return false;
+      }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu,&cpus);
+    int err = pthread_setaffinity_np(thread,sizeof(cpus),&cpus);
+    if (err!=0)
+      {
+	ROS_WARN_STREAM("RT setup: could not pin the " << name
+			<< " thread on CPU " << cpu << ": " << strerror(err));
+	return false;
+      }
+    ROS_INFO_STREAM("RT setup: " << name << " thread pinned on CPU " << cpu);
+    return true;
+  }
+
+  bool setThreadPriority(pthread_t thread, int priority,
+			 const std::string &name)
+  {
+    struct sched_param param;
+    memset(&param,0,sizeof(param));
+    param.sched_priority = priority;
+    int err = pthread_setschedparam(thread,SCHED_FIFO,&param);
+    if (err!=0)
+      {
+	ROS_WARN_STREAM("RT setup: could not set SCHED_FIFO " << priority
+			<< " for the " << name << " thread: "
+			<< strerror(err));
+	return false;
+      }
+    ROS_INFO_STREAM("RT setup: " << name << " thread in SCHED_FIFO "
+		    << priority);
+    return true;
+  }
+}
@@ -0,0 +1,48 @@
+/*
+   Preparation of the process and of the threads for real-time execution.
+*/
+
+#ifndef _RC_SOT_RT_SETUP_H_
+#define _RC_SOT_RT_SETUP_H_
+
+#include <pthread.h>
+#include <cstddef>
+#include <string>
+
+namespace sot_controller
+{
+  /// \brief Real-time settings read from /sot_controller/rt.
+  struct RealTimeSetup
+  {
+    /// Lock the current and future pages of the process in memory.
+    bool lock_memory;
+    /// Touch the pages of the log buffers.
+    bool prefault_log;
+    /// Size of the stack of the control thread to touch, in bytes.
+    int prefault_stack;
+    /// CPU of the worker thread, -1 to keep the affinity.
+    int worker_cpu;
+    /// SCHED_FIFO priority of the worker thread, 0 to keep the policy.
+    int worker_priority;
+
+    RealTimeSetup();
+  };
+
+  /// \brief Lock the memory of the process. Each function of this file
+  /// reports its outcome on ROS and returns false on failure.
+  bool lockMemory();
+
+  /// \brief Touch size bytes of the stack of the calling thread.
+  /// size is reduced to what the stack can hold, with a margin.
+  bool prefaultStack(std::size_t size);
+
+  /// \brief Pin a thread on a CPU.
+  bool setThreadAffinity(pthread_t thread, int cpu,
+			 const std::string &name);
+
+  /// \brief Run a thread with the SCHED_FIFO policy.
+  bool setThreadPriority(pthread_t thread, int priority,
+			 const std::string &name);
+}
+
+#endif /* _RC_SOT_RT_SETUP_H_ */
@@ -0,0 +1,89 @@
+/*
+   Whole-body PD controller used in effort mode while the dynamic graph
+   is not running.
+*/
+#include "standby-pd-controller.hh"
+
+#include <cmath>
+#include <limits>
+
+namespace sot_controller
+{
+  StandbyPDController::StandbyPDController()
+  {
+  }
+
+  void StandbyPDController::resize(unsigned int nbJoints)
+  {
+    const double inf = std::numeric_limits<double>::infinity();
+
+    p_gain_.setZero(nbJoints);
+    i_gain_.setZero(nbJoints);
+    d_gain_.setZero(nbJoints);
+    i_term_min_.setConstant(nbJoints,-inf);
+    i_term_max_.setConstant(nbJoints,inf);
+    i_error_min_.setConstant(nbJoints,-inf);
+    i_error_max_.setConstant(nbJoints,inf);
+
+    des_pos_.setZero(nbJoints);
+    position_.setZero(nbJoints);
+    velocity_.setZero(nbJoints);
+    i_error_.setZero(nbJoints);
+    command_.setZero(nbJoints);
+    error_.setZero(nbJoints);
+    valid_.setConstant(nbJoints,true);
+  }
+
+  void StandbyPDController::
+  setGains(unsigned int i, const control_toolbox::Pid::Gains &gains)
+  {
+    const double inf = std::numeric_limits<double>::infinity();
+
+    p_gain_[i] = gains.p_gain_;
+    i_gain_[i] = gains.i_gain_;
+    d_gain_[i] = gains.d_gain_;
+
+    /// Same rules as control_toolbox::Pid: the integral term is always
+    /// clamped, and with anti-windup (and a non-zero gain) the integrated
+    /// error is bounded too.
+    i_term_min_[i] = gains.i_min_;
+    i_term_max_[i] = gains.i_max_;
+    i_error_min_[i] = -inf;
+    i_error_max_[i] = inf;
+    if (gains.antiwindup_ && gains.i_gain_!=0.0)
+      {
+	i_error_min_[i] = gains.i_min_/std::fabs(gains.i_gain_);
+	i_error_max_[i] = gains.i_max_/std::fabs(gains.i_gain_);
+      }
+  }
+
+  void StandbyPDController::reset()
+  {
+    i_error_.setZero();
+    command_.setZero();
+  }
+
+  void StandbyPDController::computeCommand(double dt)
+  {
+    /// control_toolbox::Pid does not send any command for a null,
+    /// NaN or infinite period.
+    if (dt==0.0 || !(dt-dt==0.0))
+      {
+	command_.setZero();
+	return;
+      }
+
+    /// Nor for a NaN or infinite error, whose integrator is left as is:
+    /// x-x is 0 only for a finite x. The desired velocity is zero.
+    error_ = des_pos_ - position_;
+    valid_ = (error_-error_==0.0) && (velocity_-velocity_==0.0);
+    i_error_ = valid_.select((i_error_ + dt*error_)
+			     .max(i_error_min_).min(i_error_max_),
+			     i_error_);
+    command_ = valid_.select(p_gain_*error_
+			     + (i_gain_*i_error_).max(i_term_min_)
+			     .min(i_term_max_)
+			     - d_gain_*velocity_,
+			     0.0);
+  }
+}
@@ -0,0 +1,79 @@
+/*
+   Whole-body PD controller used in effort mode while the dynamic graph
+   is not running.
+*/
+
+#ifndef _RC_SOT_STANDBY_PD_CONTROLLER_H_
+#define _RC_SOT_STANDBY_PD_CONTROLLER_H_
+
+#include <Eigen/Core>
+#include <control_toolbox/pid.h>
+
+namespace sot_controller
+{
+  /// \brief Compute the command of all the joints in one pass.
+  /// Gains, errors and integrator states are stored in contiguous arrays.
+  /// The control law is the one of control_toolbox::Pid::computeCommand:
+  /// the integral term is clamped to [i_min,i_max], with anti-windup the
+  /// integrated error is also bounded by i_min/|i| and i_max/|i|, and a
+  /// joint with a NaN or infinite error gets no command.
+  class StandbyPDController
+  {
+  public:
+    StandbyPDController();
+
+    /// \brief Allocate the arrays for nbJoints joints and reset the states.
+    void resize(unsigned int nbJoints);
+
+    /// \brief Number of joints handled by the controller.
+    unsigned int size() const
+    { return (unsigned int)p_gain_.size(); }
+
+    /// \brief Copy the gains of joint i.
+    void setGains(unsigned int i, const control_toolbox::Pid::Gains &gains);
+
+    /// \brief Set the desired position of joint i.
+    void setDesiredPosition(unsigned int i, double des_pos)
+    { des_pos_[i] = des_pos; }
+
+    /// \brief Set the measured position and velocity of joint i.
+    void setState(unsigned int i, double position, double velocity)
+    {
+      position_[i] = position;
+      velocity_[i] = velocity;
+    }
+
+    /// \brief Command of joint i computed by the last call to computeCommand.
+    double command(unsigned int i) const
+    { return command_[i]; }
+
+    /// \brief Reset the integrator states.
+    void reset();
+
+    /// \brief Compute the command of every joint for the period dt (in s).
+    void computeCommand(double dt);
+
+  private:
+    typedef Eigen::ArrayXd Array;
+    typedef Eigen::Array<bool,Eigen::Dynamic,1> ArrayXb;
+
+    /// @{ \name Gains
+    Array p_gain_, i_gain_, d_gain_;
+    /// Bounds on the integral term.
+    Array i_term_min_, i_term_max_;
+    /// Bounds on the integrated error (anti-windup).
+    Array i_error_min_, i_error_max_;
+    /// @}
+
+    /// @{ \name States
+    Array des_pos_, position_, velocity_;
+    Array i_error_;
+    Array command_;
+    /// Position error and its validity, allocated once.
+    Array error_;
+    ArrayXb valid_;
+    /// @}
+  };
+}
+
+#endif /* _RC_SOT_STANDBY_PD_CONTROLLER_H_ */
@@ -0,0 +1,93 @@
+/*
+   Choice of the hardware iterations where the SoT is evaluated.
+*/
+#include "subsampling-scheduler.hh"
+
+namespace sot_controller
+{
+  /// The SoT period is a multiple of the mean hardware period when they
+  /// match within 1/RATIO_TOLERANCE of the SoT period. The jitter is not
+  /// used here: it can be larger than the gap between two ratios.
+  static const int64_t RATIO_TOLERANCE = 1000;
+
+  SubsamplingScheduler::SubsamplingScheduler():
+    period_(0),
+    jitter_(0)
+  {
+    reset();
+  }
+
+  void SubsamplingScheduler::setPeriod(int64_t period, int64_t jitter)
+  {
+    period_ = period;
+    jitter_ = jitter;
+  }
+
+  void SubsamplingScheduler::reset()
+  {
+    accumulated_ = 0;
+    elapsed_ = 0;
+    updates_ = 0;
+    ticks_ = 0;
+    skipped_ = 0;
+    since_tick_ = 0;
+  }
+
+  int64_t SubsamplingScheduler::meanHardwarePeriod() const
+  {
+    if (updates_==0 || elapsed_<=0)
+      return 0;
+    return elapsed_/(int64_t)updates_;
+  }
+
+  unsigned int SubsamplingScheduler::decimation() const
+  {
+    int64_t mean = meanHardwarePeriod();
+    if (mean<=0)
+      return 0;
+    int64_t ratio = (period_+mean/2)/mean;
+    int64_t error = ratio*mean-period_;
+    int64_t tolerance = period_/RATIO_TOLERANCE;
+    if (ratio==0 || error>tolerance || error<-tolerance)
+      return 0;
+    return (unsigned int)ratio;
+  }
+
+  bool SubsamplingScheduler::update(int64_t hardwarePeriod)
+  {
+    elapsed_ += hardwarePeriod;
+    accumulated_ += hardwarePeriod;
+    updates_++;
+    since_tick_++;
+
+    unsigned int ratio = decimation();
+    if (ratio>0)
+      {
+	if (since_tick_<ratio)
+	  return false;
+	accumulated_ = 0;
+      }
+    else
+      {
+	if (accumulated_<period_-jitter_)
+	  return false;
+	accumulated_ -= period_;
+	// After a pause longer than a period, do not try to catch up.
+	if (period_>0 && accumulated_>=period_)
+	  {
+	    skipped_ += (uint64_t)(accumulated_/period_);
+	    accumulated_ %= period_;
+	  }
+      }
+    since_tick_ = 0;
+    ticks_++;
+    return true;
+  }
+
+  double SubsamplingScheduler::achievedRate() const
+  {
+    if (elapsed_<=0)
+      return 0.0;
+    return 1e9*(double)ticks_/(double)elapsed_;
+  }
+}
@@ -0,0 +1,58 @@
+/*
+   Choice of the hardware iterations where the SoT is evaluated.
+*/
+
+#ifndef _RC_SOT_SUBSAMPLING_SCHEDULER_H_
+#define _RC_SOT_SUBSAMPLING_SCHEDULER_H_
+
+#include <stdint.h>
+
+namespace sot_controller
+{
+  /// \brief Subsample the hardware loop at the period of the SoT.
+  /// When the SoT period is a multiple of the mean hardware period
+  /// (within 0.1%), the SoT is evaluated every N hardware iterations
+  /// whatever the jitter of each period. Otherwise the time is accumulated
+  /// in integer ns and one SoT period is removed at each tick: the
+  /// remainder keeps the phase, so the long-run rate is exactly 1/period.
+  class SubsamplingScheduler
+  {
+  public:
+    SubsamplingScheduler();
+
+    /// \brief Period of the SoT and tolerance of a tick, in ns.
+    void setPeriod(int64_t period, int64_t jitter);
+
+    /// \brief Restart the accumulation and the statistics.
+    void reset();
+
+    /// \brief Advance by one hardware period (in ns).
+    /// Returns true if the SoT has to be evaluated.
+    bool update(int64_t hardwarePeriod);
+
+    /// \brief Number of hardware iterations between two ticks,
+    /// 0 if the SoT period is not a multiple of the hardware period.
+    unsigned int decimation() const;
+
+    /// \brief Mean hardware period in ns, 0 before any update.
+    int64_t meanHardwarePeriod() const;
+
+    /// \brief Number of ticks since reset.
+    uint64_t ticks() const { return ticks_; }
+    /// \brief Number of SoT periods dropped after a pause.
+    uint64_t skipped() const { return skipped_; }
+    /// \brief Hardware time since reset in ns.
+    int64_t elapsed() const { return elapsed_; }
+    /// \brief Achieved rate of the ticks in Hz, 0 before any time elapsed.
+    double achievedRate() const;
+
+  private:
+    int64_t period_, jitter_;
+    int64_t accumulated_, elapsed_;
+    uint64_t updates_, ticks_, skipped_;
+    // Hardware iterations since the last tick.
+    unsigned int since_tick_;
+  };
+}
+
+#endif /* _RC_SOT_SUBSAMPLING_SCHEDULER_H_ */
@@ -0,0 +1,115 @@
+/*
+   Checks that fillImu does not allocate memory, with 1, 2 and 4 IMUs
+   on a mock robot (mock-robot-hw.hh). The labels of the IMUs are
+   resolved once in initIMU: each tick only copies the values.
+
+   The controller reads its parameters from the parameter server: the
+   test is skipped (exit code 77) without a roscore.
+*/
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include <ros/ros.h>
+
+#include "hot-path-controller.hh"
+
+/// Allocations made by the thread under test while counting is on.
+/// The other threads (ROS) are not counted.
+static __thread bool counting = false;
+static __thread unsigned long nbAllocations = 0;
+
+static void * countedAlloc(std::size_t size)
+{
+  if (counting)
+    nbAllocations++;
+  void *p = malloc(size>0 ? size : 1);
+  if (p==NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+#if __cplusplus >= 201103L
+#define THROW_BAD_ALLOC
+#define THROW_NOTHING noexcept
+#else
+#define THROW_BAD_ALLOC throw(std::bad_alloc)
+#define THROW_NOTHING throw()
+#endif
+
+void * operator new(std::size_t size) THROW_BAD_ALLOC
+{ return countedAlloc(size); }
+void * operator new[](std::size_t size) THROW_BAD_ALLOC
+{ return countedAlloc(size); }
+void operator delete(void *p) THROW_NOTHING { free(p); }
+void operator delete[](void *p) THROW_NOTHING { free(p); }
+#if __cpp_sized_deallocation >= 201309L
+void operator delete(void *p, std::size_t) noexcept { free(p); }
+void operator delete[](void *p, std::size_t) noexcept { free(p); }
+#endif
+
+static const unsigned int NB_DOFS = 12;
+static const unsigned int NB_TICKS = 1000;
+
+/// Expose the values of the IMUs to the SoT device.
+static void mapImus(unsigned int nbImus)
+{
+  std::map<std::string,std::string> mapping;
+  ros::param::get("/sot_controller/map_rc_to_sot_device",mapping);
+  const char * quantities[3] = { "orientation_", "gyrometer_", "accelerometer_" };
+  for(unsigned int i=0;i<nbImus;i++)
+    for(unsigned int q=0;q<3;q++)
+      {
+	std::ostringstream label;
+	label << quantities[q] << i;
+	mapping[label.str()] = label.str();
+      }
+  ros::param::set("/sot_controller/map_rc_to_sot_device",mapping);
+}
+
+/// Returns the number of allocations per tick, -1 on failure.
+static double allocationsPerTick(unsigned int nbImus)
+{
+  MockRobotHW robot(NB_DOFS,nbImus,4);
+  setControllerParams(robot,"POSITION",1e-3);
+  mapImus(nbImus);
+  HotPathController controller;
+  if (!controller.initOnMock(robot))
+    return -1.0;
+
+  nbAllocations = 0;
+  counting = true;
+  for(unsigned int k=0;k<NB_TICKS;k++)
+    controller.benchFillImu();
+  counting = false;
+  return (double)nbAllocations/NB_TICKS;
+}
+
+int main(int argc, char *argv[])
+{
+  ros::init(argc,argv,"roscontrol_sot_test_fill_imu_alloc");
+  if (!ros::master::check())
+    {
+      std::cerr << "No roscore: test skipped." << std::endl;
+      return 77;
+    }
+
+  const unsigned int nbImus[3] = { 1, 2, 4 };
+  bool ok = true;
+  for(unsigned int i=0;i<3;i++)
+    {
+      double allocations = allocationsPerTick(nbImus[i]);
+      bool passed = allocations==0.0;
+      std::cout << (passed ? "OK" : "FAILED") << ": fillImu with "
+		<< nbImus[i] << " IMUs, ";
+      if (allocations<0.0)
+	std::cout << "the controller failed to initialize" << std::endl;
+      else
+	std::cout << allocations << " allocations per tick" << std::endl;
+      ok = ok && passed;
+    }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+/*
+   Records the log while it is saved in the background, as stopping()
+   does it: the saved file has to hold consecutive samples, and the
+   samples recorded during the save have to be in the next save.
+
+   Usage: roscontrol-sot-test-log-save-async [prefix]
+*/
+#include <stdint.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "log.hh"
+#include "log-format.hh"
+
+using namespace rc_sot_system;
+
+static const unsigned int NB_DOFS = 12;
+static const unsigned int LENGTH = 20000;
+
+static bool check(bool condition, const std::string &message)
+{
+  if (!condition)
+    std::cerr << "FAILED: " << message << std::endl;
+  return condition;
+}
+
+/// Record one sample whose first motor angle is its index.
+static void recordSample(Log &log, DataToLog &data, unsigned int k)
+{
+  data.motor_angle[0] = (double)k;
+  log.start_it();
+  log.stop_it();
+  log.record(data);
+}
+
+/// Read the first motor angle of each sample of a container.
+static bool readMotorAngle(const std::string &filename,
+			   std::vector<double> &values)
+{
+  std::ifstream in(filename.c_str(),std::ios::binary);
+  LogHeader header;
+  if (!check(readLogHeader(in,header),"cannot read " + filename))
+    return false;
+  for(std::size_t i=0;i<header.channels.size();i++)
+    if (header.channels[i].name=="motor_angle")
+      {
+	values.resize(header.nbSamples);
+	in.seekg(header.channels[i].offset);
+	in.read((char*)&values[0],values.size()*sizeof(double));
+	return check(in.good(),"truncated file " + filename);
+      }
+  return check(false,"no motor_angle in " + filename);
+}
+
+/// The samples of the file are consecutive, include the sample
+/// "included", and end between last and lastMax.
+static bool checkSamples(const std::string &filename, double included,
+			 double last, double lastMax)
+{
+  std::vector<double> values;
+  if (!readMotorAngle(filename,values))
+    return false;
+  if (!check(!values.empty(),"no sample in " + filename))
+    return false;
+  bool ok = true;
+  for(std::size_t k=1;k<values.size();k++)
+    if (!check(values[k]==values[k-1]+1.0,"gap in " + filename))
+      return false;
+  ok = check(values.front()<=included && values.back()>=included,
+	     "samples missing in " + filename) && ok;
+  ok = check(values.back()>=last && values.back()<=lastMax,
+	     "last sample missing in " + filename) && ok;
+  std::cout << filename << ": samples " << values.front() << " to "
+	    << values.back() << std::endl;
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  std::string prefix(argc>1 ? argv[1] : "/tmp/test-log-save-async");
+  std::string first = prefix + "-first.log", second = prefix + "-second.log";
+  bool ok = true;
+
+  Log log;
+  log.setFormat(LOG_FORMAT_CONTAINER);
+  log.init(NB_DOFS,LENGTH);
+  DataToLog data;
+  data.init(NB_DOFS,1);
+
+  /// Wrap the circular buffer, then save while recording at 10 kHz.
+  unsigned int k = 0;
+  for(;k<LENGTH+LENGTH/2;k++)
+    recordSample(log,data,k);
+  const unsigned int lastBeforeSave = k-1;
+  ok = check(log.saveAsync(first),"saveAsync refused") && ok;
+  while (log.saveStatus()==SAVE_RUNNING)
+    {
+      recordSample(log,data,k++);
+      usleep(100);
+    }
+  const unsigned int duringSave = k-1-lastBeforeSave;
+  ok = check(log.saveStatus()==SAVE_DONE,"first save failed") && ok;
+  /// The copy of the buffer may be taken after a few more samples.
+  ok = checkSamples(first,(double)lastBeforeSave,(double)lastBeforeSave,
+		    (double)(k-1)) && ok;
+
+  /// The samples recorded during the first save are kept.
+  for(unsigned int i=0;i<100;i++)
+    recordSample(log,data,k++);
+  ok = check(log.save(second),"second save failed") && ok;
+  ok = checkSamples(second,(double)(lastBeforeSave+1),(double)(k-1),
+		    (double)(k-1)) && ok;
+
+  std::cout << (ok ? "OK" : "FAILED") << ": " << duringSave
+	    << " samples recorded during the background save" << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+/*
+   Streams the log across two start/stop cycles of the controller, as
+   starting() and stopping() do it: the samples of both cycles have to
+   be in the stream file and none may be dropped.
+   Then streams from a process killed without stopping: the header of
+   the file has to count the samples written before the kill.
+
+   Usage: roscontrol-sot-test-log-stream [prefix]
+*/
+#include <signal.h>
+#include <stdint.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "log.hh"
+
+using namespace rc_sot_system;
+
+static const unsigned int NB_DOFS = 12;
+static const unsigned int NB_SAMPLES = 2000;
+
+static bool check(bool condition, const std::string &message)
+{
+  if (!condition)
+    std::cerr << "FAILED: " << message << std::endl;
+  return condition;
+}
+
+/// Record nbSamples samples whose first motor angle is their index.
+static void recordSamples(Log &log, unsigned int first,
+			  unsigned int nbSamples)
+{
+  DataToLog data;
+  data.init(NB_DOFS,1);
+  for(unsigned int k=0;k<nbSamples;k++)
+    {
+      data.motor_angle[0] = (double)(first+k);
+      log.start_it();
+      log.stop_it();
+      log.record(data);
+    }
+}
+
+/// Record nbSamples samples, then stop the controller.
+static bool runCycle(Log &log, unsigned int first, unsigned int nbSamples,
+		     std::string &prefix)
+{
+  recordSamples(log,first,nbSamples);
+  if (!check(log.saveAsync(prefix),"saveAsync refused the stop"))
+    return false;
+  log.waitSave();
+  return check(log.saveStatus()==SAVE_DONE,"the stream file is not synced");
+}
+
+/// Number of samples in the header of the stream file, 0 if unreadable.
+static unsigned int headerSamples(const std::string &filename)
+{
+  unsigned int nVector = 0;
+  FILE *file = fopen(filename.c_str(),"rb");
+  if (file==NULL)
+    return 0;
+  if (fread(&nVector,sizeof(unsigned int),1,file)!=1)
+    nVector = 0;
+  fclose(file);
+  return nVector;
+}
+
+/// Read the stream file back: the header and the rows have to hold
+/// nbSamples samples in order.
+static bool checkStream(const std::string &filename, unsigned int nbSamples)
+{
+  FILE *file = fopen(filename.c_str(),"rb");
+  if (!check(file!=NULL,"no stream file " + filename))
+    return false;
+  unsigned int nVector = 0, vectorSize = 0;
+  bool ok = check(fread(&nVector,sizeof(unsigned int),1,file)==1 &&
+		  fread(&vectorSize,sizeof(unsigned int),1,file)==1,
+		  "truncated header");
+  ok = check(nVector==nbSamples,"wrong number of samples in the header")
+    && ok;
+  std::vector<double> row(vectorSize>2 ? vectorSize : 3);
+  unsigned int nbRows = 0;
+  double t = -1.0;
+  while (fread(&row[0],sizeof(double),vectorSize,file)==vectorSize)
+    {
+      /// Columns: t, dt, then the motor angles.
+      ok = check(row[0]>=t,"time going backward") && ok;
+      ok = check(row[2]==(double)nbRows,"sample out of order") && ok;
+      t = row[0];
+      nbRows++;
+    }
+  fclose(file);
+  ok = check(nbRows==nbSamples,"wrong number of rows in the file") && ok;
+  std::cout << filename << ": " << nbRows << " samples" << std::endl;
+  return ok;
+}
+
+/// Stream from a child process killed without stopping.
+static bool runKilled(std::string prefix)
+{
+  std::string filename = prefix + "-stream.log";
+  pid_t pid = fork();
+  if (pid==0)
+    {
+      Log log;
+      log.initStreaming(NB_DOFS,prefix,NB_SAMPLES);
+      recordSamples(log,0,NB_SAMPLES);
+      /// Let the writer thread catch up, at most 5 s.
+      for(unsigned int i=0;i<500 && headerSamples(filename)<NB_SAMPLES;i++)
+	usleep(10000);
+      kill(getpid(),SIGKILL);
+    }
+  int status = 0;
+  if (!check(pid>0 && waitpid(pid,&status,0)==pid,"fork failed"))
+    return false;
+  if (!check(WIFSIGNALED(status) && WTERMSIG(status)==SIGKILL,
+	     "the streaming process was not killed"))
+    return false;
+  return checkStream(filename,NB_SAMPLES);
+}
+
+int main(int argc, char *argv[])
+{
+  std::string prefix(argc>1 ? argv[1] : "/tmp/test-log-stream");
+  bool ok = true;
+  {
+    Log log;
+    /// The queue holds all the samples: none may be dropped even if
+    /// the writer thread is slow.
+    log.initStreaming(NB_DOFS,prefix,2*NB_SAMPLES);
+    ok = runCycle(log,0,NB_SAMPLES,prefix) && ok;
+    ok = runCycle(log,NB_SAMPLES,NB_SAMPLES,prefix) && ok;
+    ok = check(log.streamedSamples()==2*NB_SAMPLES,
+	       "samples missing from the queue") && ok;
+    ok = check(log.droppedSamples()==0,"samples dropped") && ok;
+  }
+  ok = checkStream(prefix + "-stream.log",2*NB_SAMPLES) && ok;
+  ok = runKilled(prefix + "-killed") && ok;
+
+  std::cout << (ok ? "OK" : "FAILED") << ": streamed over two cycles"
+	    << " and from a killed process" << std::endl;
+  return ok ? 0 : 1;
+}
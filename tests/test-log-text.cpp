@@ -0,0 +1,130 @@
+/*
+   Text of the doubles written by roscontrol-sot-parse-log: each text has
+   to read back as the same double. With std::to_chars it has to be the
+   shortest one, otherwise the text of %.17g.
+
+   Usage: roscontrol-sot-test-log-text [nbValues]
+*/
+#include <stdint.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "log-text.hh"
+
+using namespace rc_sot_system;
+
+/// Deterministic 64 bits generator (xorshift64*).
+static uint64_t nextRandom(uint64_t &state)
+{
+  state ^= state>>12;
+  state ^= state<<25;
+  state ^= state>>27;
+  return state*2685821657736338717ULL;
+}
+
+static double fromBits(uint64_t bits)
+{
+  double v;
+  memcpy(&v,&bits,sizeof(double));
+  return v;
+}
+
+static unsigned int nbFailures = 0;
+
+static void fail(double v, const char *text, const char *expected)
+{
+  if (nbFailures++<10)
+    fprintf(stderr,"FAILED: %.17g written %s, expected %s\n",
+	    v,text,expected);
+}
+
+/// The text of v reads back as v, NaN as NaN.
+static void checkRoundTrip(double v)
+{
+  char text[MAX_DOUBLE_TEXT+1];
+  text[formatDouble(v,text)] = '\0';
+  double back = strtod(text,NULL);
+  if (v==v ? back!=v || std::signbit(back)!=std::signbit(v) : back==back)
+    fail(v,text,"the same value");
+}
+
+/// The text of v is expected.
+static void checkText(double v, const char *expected)
+{
+  char text[MAX_DOUBLE_TEXT+1];
+  text[formatDouble(v,text)] = '\0';
+  if (strcmp(text,expected)!=0)
+    fail(v,text,expected);
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned int nbValues = 200000;
+  if (argc>1)
+    nbValues = (unsigned int)atoi(argv[1]);
+
+  const double edges[] =
+    { 0.0, -0.0, 1.0, -1.0, 0.1, 0.2, 0.3, 1.0/3.0, 2.0/3.0, 1e-5, 1e-4,
+      9.9999999999999995e-5, 123456789012345.0, 1234567890123456.0,
+      12345678901234567.0, 9007199254740992.0, 9007199254740993.0,
+      1e15, 1e16, 1e17, 1e22, 1e23, 1e300, 1e-300, 4.35, 0.000123456,
+      M_PI, -M_PI, std::numeric_limits<double>::min(),
+      std::numeric_limits<double>::max(),
+      std::numeric_limits<double>::denorm_min(),
+      std::numeric_limits<double>::epsilon(),
+      std::numeric_limits<double>::infinity(),
+      -std::numeric_limits<double>::infinity(),
+      std::numeric_limits<double>::quiet_NaN() };
+  unsigned int nbEdges = sizeof(edges)/sizeof(double);
+  for(unsigned int i=0;i<nbEdges;i++)
+    checkRoundTrip(edges[i]);
+
+#ifdef RC_SOT_LOG_TEXT_SHORTEST
+  checkText(0.1,"0.1");
+  checkText(0.3,"0.3");
+  checkText(-1.5,"-1.5");
+  checkText(1.0/3.0,"0.3333333333333333");
+  checkText(std::numeric_limits<double>::denorm_min(),"5e-324");
+  checkText(std::numeric_limits<double>::max(),"1.7976931348623157e+308");
+  checkText(1e22,"1e+22");
+#else
+  for(unsigned int i=0;i<nbEdges;i++)
+    {
+      char expected[MAX_DOUBLE_TEXT+1];
+      snprintf(expected,sizeof(expected),"%.17g",edges[i]);
+      checkText(edges[i],expected);
+    }
+#endif
+
+  uint64_t state = 88172645463325252ULL;
+  for(unsigned int i=0;i<nbValues;i++)
+    {
+      /// Any bit pattern, NaN included.
+      checkRoundTrip(fromBits(nextRandom(state)));
+      /// Values of a log: joint angles, torques, times.
+      double u = (double)(nextRandom(state)>>11)*(1.0/9007199254740992.0);
+      checkRoundTrip(2.0*M_PI*(u-0.5));
+      checkRoundTrip(200.0*(u-0.5));
+      checkRoundTrip(1e-3*(double)i+u*1e-6);
+      /// Powers of two and their neighbours.
+      int e = (int)(nextRandom(state)%200)-100;
+      double p = std::ldexp(1.0,e);
+      checkRoundTrip(p);
+      checkRoundTrip(nextafter(p,0.0));
+      checkRoundTrip(nextafter(p,1e308));
+    }
+
+  std::cout << (nbFailures==0 ? "OK" : "FAILED") << ": "
+#ifdef RC_SOT_LOG_TEXT_SHORTEST
+	    << "shortest text, "
+#else
+	    << "%.17g, "
+#endif
+	    << nbEdges+7*nbValues << " values, " << nbFailures
+	    << " failures" << std::endl;
+  return nbFailures==0 ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+/*
+   Rate and phase of the ticks of SubsamplingScheduler on the hardware
+   loops of subsampling-cases.hh.
+
+   The scheduler has to achieve the SoT rate within 0.1%, and its phase
+   error has to stay under one hardware period plus the jitter of two
+   wake-ups and the configured jitter (a tick may come that much early).
+
+   Usage: roscontrol-sot-test-subsampling-scheduler [nbIterations]
+*/
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "subsampling-cases.hh"
+
+int main(int argc, char *argv[])
+{
+  unsigned int nbIterations = 1000000;
+  if (argc>1)
+    nbIterations = (unsigned int)atoi(argv[1]);
+
+  bool ok = true;
+  for(unsigned int i=0;i<NB_SUBSAMPLING_CASES;i++)
+    {
+      const SubsamplingCase &c = SUBSAMPLING_CASES[i];
+      SubsamplingResult result = runScheduler(c,nbIterations);
+      double target = 1e9/(double)c.dt;
+      double maxPhase = 1e-3*(double)(c.hw + 2*c.hw_jitter + c.jitter);
+      bool rate = std::fabs(result.rate-target)<=1e-3*target;
+      bool phase = result.phase_error<=maxPhase;
+      if (!rate || !phase)
+	std::cerr << "FAILED: hw " << 1e-3*(double)c.hw << "us, jitter "
+		  << 1e-3*(double)c.hw_jitter << "us, dt "
+		  << 1e-3*(double)c.dt << "us, configured jitter "
+		  << 1e-3*(double)c.jitter << "us: "
+		  << result.rate << " Hz for " << target << " Hz, phase error "
+		  << result.phase_error << " us for at most " << maxPhase
+		  << " us" << std::endl;
+      ok = ok && rate && phase;
+    }
+
+  std::cout << (ok ? "OK" : "FAILED") << ": " << NB_SUBSAMPLING_CASES
+	    << " hardware loops" << std::endl;
+  return ok ? 0 : 1;
+}